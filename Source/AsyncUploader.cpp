@@ -0,0 +1,395 @@
+#include "AsyncUploader.hpp"
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+
+bool AsyncUploader::Initialize(
+    VkDevice device,
+    VmaAllocator allocator,
+    VkQueue transferQueue,
+    uint32_t transferQueueFamily,
+    uint32_t graphicsQueueFamily)
+{
+    _device = device;
+    _allocator = allocator;
+    _transferQueue = transferQueue;
+    _transferQueueFamily = transferQueueFamily;
+    _graphicsQueueFamily = graphicsQueueFamily;
+
+    if (vkCreateCommandPool(
+        _device,
+        ToTempPtr(VkCommandPoolCreateInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VkCommandPoolCreateFlagBits::VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = _transferQueueFamily,
+        }),
+        nullptr,
+        &_commandPool) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    if (vkCreateSemaphore(
+        _device,
+        ToTempPtr(VkSemaphoreCreateInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = ToTempPtr(VkSemaphoreTypeCreateInfo
+            {
+                .sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+                .pNext = nullptr,
+                .semaphoreType = VkSemaphoreType::VK_SEMAPHORE_TYPE_TIMELINE,
+                .initialValue = 0,
+            }),
+        }),
+        nullptr,
+        &_timelineSemaphore) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void AsyncUploader::Destroy()
+{
+    WaitIdle();
+
+    for (auto& pendingUpload : _pendingUploads)
+    {
+        vmaDestroyBuffer(_allocator, pendingUpload.stagingBuffer.buffer, pendingUpload.stagingBuffer.allocation);
+    }
+    _pendingUploads.clear();
+
+    vkDestroySemaphore(_device, _timelineSemaphore, nullptr);
+    vkDestroyCommandPool(_device, _commandPool, nullptr);
+    _timelineSemaphore = {};
+    _commandPool = {};
+}
+
+std::expected<UploadBatch, std::string> AsyncUploader::BeginBatch(VkDeviceSize stagingCapacity)
+{
+    ZoneScoped;
+
+    UploadBatch batch;
+    batch.stagingBuffer.bufferSize = stagingCapacity;
+
+    VmaAllocationInfo allocationInfo = {};
+    if (vmaCreateBuffer(
+        _allocator,
+        ToTempPtr(VkBufferCreateInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = stagingCapacity,
+            .usage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+        }),
+        ToTempPtr(ToAllocationCreateInfo(MemoryPlacement::HostVisible)),
+        &batch.stagingBuffer.buffer,
+        &batch.stagingBuffer.allocation,
+        &allocationInfo) != VK_SUCCESS)
+    {
+        return std::unexpected("AsyncUploader: Failed to create staging buffer");
+    }
+
+    batch.stagingBuffer.mappedData = allocationInfo.pMappedData;
+
+    return batch;
+}
+
+void* AsyncUploader::Reserve(
+    UploadBatch& batch,
+    VkBuffer destinationBuffer,
+    VkDeviceSize destinationOffset,
+    VkDeviceSize dataSize)
+{
+    if (batch.stagingSize + dataSize > batch.stagingBuffer.bufferSize)
+    {
+        return nullptr;
+    }
+
+    auto stagingOffset = batch.stagingSize;
+    batch.stagingSize += dataSize;
+
+    // Neighbouring allocations from the geometry pool end up as one copy region and one barrier
+    if (!batch.regions.empty())
+    {
+        auto& lastRegion = batch.regions.back();
+        if (lastRegion.destinationBuffer == destinationBuffer &&
+            lastRegion.destinationOffset + lastRegion.size == destinationOffset &&
+            lastRegion.stagingOffset + lastRegion.size == stagingOffset)
+        {
+            lastRegion.size += dataSize;
+            return static_cast<uint8_t*>(batch.stagingBuffer.mappedData) + stagingOffset;
+        }
+    }
+
+    if (dataSize > 0)
+    {
+        batch.regions.push_back(UploadRegion
+        {
+            .destinationBuffer = destinationBuffer,
+            .destinationOffset = destinationOffset,
+            .stagingOffset = stagingOffset,
+            .size = dataSize
+        });
+    }
+
+    return static_cast<uint8_t*>(batch.stagingBuffer.mappedData) + stagingOffset;
+}
+
+std::expected<uint64_t, std::string> AsyncUploader::SubmitBatch(UploadBatch& batch)
+{
+    ZoneScoped;
+
+    PendingUpload pendingUpload;
+    pendingUpload.stagingBuffer = batch.stagingBuffer;
+    pendingUpload.regions = std::move(batch.regions);
+    batch = {};
+
+    auto destroyStagingBuffer = [&]()
+    {
+        vmaDestroyBuffer(_allocator, pendingUpload.stagingBuffer.buffer, pendingUpload.stagingBuffer.allocation);
+    };
+
+    if (vkAllocateCommandBuffers(
+        _device,
+        ToTempPtr(VkCommandBufferAllocateInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .commandPool = _commandPool,
+            .level = VkCommandBufferLevel::VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        }),
+        &pendingUpload.commandBuffer) != VK_SUCCESS)
+    {
+        destroyStagingBuffer();
+        return std::unexpected("AsyncUploader: Failed to allocate command buffer");
+    }
+
+    auto commandBuffer = pendingUpload.commandBuffer;
+    vkBeginCommandBuffer(commandBuffer, ToTempPtr(VkCommandBufferBeginInfo
+    {
+        .sType = VkStructureType::VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext = nullptr,
+        .flags = VkCommandBufferUsageFlagBits::VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    }));
+
+    // One copy command per destination buffer, with all of its regions
+    std::sort(pendingUpload.regions.begin(), pendingUpload.regions.end(), [](const UploadRegion& left, const UploadRegion& right)
+    {
+        return std::tie(left.destinationBuffer, left.destinationOffset) < std::tie(right.destinationBuffer, right.destinationOffset);
+    });
+
+    std::vector<VkBufferCopy> bufferCopies;
+    bufferCopies.reserve(pendingUpload.regions.size());
+    for (size_t regionIndex = 0; regionIndex < pendingUpload.regions.size(); regionIndex++)
+    {
+        auto& region = pendingUpload.regions[regionIndex];
+        bufferCopies.push_back(VkBufferCopy
+        {
+            .srcOffset = region.stagingOffset,
+            .dstOffset = region.destinationOffset,
+            .size = region.size
+        });
+
+        auto isLastRegionOfBuffer = regionIndex + 1 == pendingUpload.regions.size() ||
+            pendingUpload.regions[regionIndex + 1].destinationBuffer != region.destinationBuffer;
+        if (isLastRegionOfBuffer)
+        {
+            vkCmdCopyBuffer(
+                commandBuffer,
+                pendingUpload.stagingBuffer.buffer,
+                region.destinationBuffer,
+                static_cast<uint32_t>(bufferCopies.size()),
+                bufferCopies.data());
+            bufferCopies.clear();
+        }
+    }
+
+    // Release half of the ownership transfer, the acquire half is recorded on the graphics queue
+    if (IsOwnershipTransferRequired() && !pendingUpload.regions.empty())
+    {
+        std::vector<VkBufferMemoryBarrier> releaseBarriers;
+        releaseBarriers.reserve(pendingUpload.regions.size());
+        for (auto& region : pendingUpload.regions)
+        {
+            releaseBarriers.push_back(VkBufferMemoryBarrier
+            {
+                .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = 0,
+                .srcQueueFamilyIndex = _transferQueueFamily,
+                .dstQueueFamilyIndex = _graphicsQueueFamily,
+                .buffer = region.destinationBuffer,
+                .offset = region.destinationOffset,
+                .size = region.size
+            });
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0,
+            nullptr,
+            static_cast<uint32_t>(releaseBarriers.size()),
+            releaseBarriers.data(),
+            0,
+            nullptr);
+    }
+
+    vkEndCommandBuffer(commandBuffer);
+
+    pendingUpload.ticket = _lastSubmittedTicket + 1;
+
+    if (vkQueueSubmit(
+        _transferQueue,
+        1,
+        ToTempPtr(VkSubmitInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = ToTempPtr(VkTimelineSemaphoreSubmitInfo
+            {
+                .sType = VkStructureType::VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+                .pNext = nullptr,
+                .waitSemaphoreValueCount = 0,
+                .pWaitSemaphoreValues = nullptr,
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &pendingUpload.ticket,
+            }),
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = nullptr,
+            .pWaitDstStageMask = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &_timelineSemaphore,
+        }),
+        VK_NULL_HANDLE) != VK_SUCCESS)
+    {
+        vkFreeCommandBuffers(_device, _commandPool, 1, &commandBuffer);
+        destroyStagingBuffer();
+        return std::unexpected("AsyncUploader: Failed to submit to the transfer queue");
+    }
+
+    _lastSubmittedTicket = pendingUpload.ticket;
+    _pendingUploads.push_back(std::move(pendingUpload));
+
+    return _lastSubmittedTicket;
+}
+
+uint64_t AsyncUploader::AcquireCompletedUploads(VkCommandBuffer graphicsCommandBuffer)
+{
+    ZoneScoped;
+
+    if (_pendingUploads.empty())
+    {
+        return _lastAcquiredTicket;
+    }
+
+    uint64_t completedTicket = 0;
+    if (vkGetSemaphoreCounterValue(_device, _timelineSemaphore, &completedTicket) != VK_SUCCESS)
+    {
+        return _lastAcquiredTicket;
+    }
+
+    // Uploads are submitted to a single queue, so they complete in ticket order
+    auto firstIncompleteUpload = std::find_if(_pendingUploads.begin(), _pendingUploads.end(), [&](const PendingUpload& pendingUpload)
+    {
+        return pendingUpload.ticket > completedTicket;
+    });
+
+    if (firstIncompleteUpload == _pendingUploads.begin())
+    {
+        return _lastAcquiredTicket;
+    }
+
+    if (IsOwnershipTransferRequired())
+    {
+        std::vector<VkBufferMemoryBarrier> acquireBarriers;
+        for (auto pendingUpload = _pendingUploads.begin(); pendingUpload != firstIncompleteUpload; pendingUpload++)
+        {
+            for (auto& region : pendingUpload->regions)
+            {
+                acquireBarriers.push_back(VkBufferMemoryBarrier
+                {
+                    .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = 0,
+                    .dstAccessMask = VkAccessFlagBits::VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VkAccessFlagBits::VK_ACCESS_INDEX_READ_BIT,
+                    .srcQueueFamilyIndex = _transferQueueFamily,
+                    .dstQueueFamilyIndex = _graphicsQueueFamily,
+                    .buffer = region.destinationBuffer,
+                    .offset = region.destinationOffset,
+                    .size = region.size
+                });
+            }
+        }
+
+        // The submission waits on the timeline semaphore at vertex input, which this barrier chains onto
+        if (!acquireBarriers.empty())
+        {
+            vkCmdPipelineBarrier(
+                graphicsCommandBuffer,
+                VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VkPipelineStageFlagBits::VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                0,
+                0,
+                nullptr,
+                static_cast<uint32_t>(acquireBarriers.size()),
+                acquireBarriers.data(),
+                0,
+                nullptr);
+        }
+    }
+
+    for (auto pendingUpload = _pendingUploads.begin(); pendingUpload != firstIncompleteUpload; pendingUpload++)
+    {
+        vkFreeCommandBuffers(_device, _commandPool, 1, &pendingUpload->commandBuffer);
+        vmaDestroyBuffer(_allocator, pendingUpload->stagingBuffer.buffer, pendingUpload->stagingBuffer.allocation);
+    }
+
+    _lastAcquiredTicket = std::prev(firstIncompleteUpload)->ticket;
+    _pendingUploads.erase(_pendingUploads.begin(), firstIncompleteUpload);
+
+    return _lastAcquiredTicket;
+}
+
+void AsyncUploader::WaitIdle()
+{
+    if (_lastSubmittedTicket == 0)
+    {
+        return;
+    }
+
+    vkWaitSemaphores(
+        _device,
+        ToTempPtr(VkSemaphoreWaitInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &_timelineSemaphore,
+            .pValues = &_lastSubmittedTicket,
+        }),
+        UINT64_MAX);
+}
+
+VkSemaphore AsyncUploader::GetTimelineSemaphore() const
+{
+    return _timelineSemaphore;
+}
+
+bool AsyncUploader::IsOwnershipTransferRequired() const
+{
+    return _transferQueueFamily != _graphicsQueueFamily;
+}
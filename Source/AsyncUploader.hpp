@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vk_mem_alloc.h>
+#include <volk.h>
+
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <vector>
+
+#include "Types.hpp"
+
+struct UploadRegion
+{
+    VkBuffer destinationBuffer = {};
+    VkDeviceSize destinationOffset = 0;
+    VkDeviceSize stagingOffset = 0;
+    VkDeviceSize size = 0;
+};
+
+// Everything staged into one batch shares a single staging allocation, command buffer and submit
+struct UploadBatch
+{
+    AllocatedBuffer stagingBuffer = {};
+    VkDeviceSize stagingSize = 0;
+    std::vector<UploadRegion> regions;
+};
+
+// Copies data into device local buffers on the transfer queue without waiting for it.
+// Every submitted batch signals the next value of a timeline semaphore, the value is the batch's ticket.
+// When the transfer queue belongs to another family than the graphics queue, the copied ranges are
+// released by the transfer queue and acquired by the graphics queue before they get drawn from
+class AsyncUploader
+{
+public:
+    bool Initialize(
+        VkDevice device,
+        VmaAllocator allocator,
+        VkQueue transferQueue,
+        uint32_t transferQueueFamily,
+        uint32_t graphicsQueueFamily);
+    void Destroy();
+
+    // stagingCapacity has to cover everything staged into the batch
+    std::expected<UploadBatch, std::string> BeginBatch(VkDeviceSize stagingCapacity);
+    // Hands out mapped staging memory for the caller to fill before SubmitBatch, and records the copy
+    // into destinationBuffer. Returns nullptr when the batch is out of space
+    void* Reserve(
+        UploadBatch& batch,
+        VkBuffer destinationBuffer,
+        VkDeviceSize destinationOffset,
+        VkDeviceSize dataSize);
+    // Returns the ticket the batch completes with, the batch is consumed either way
+    std::expected<uint64_t, std::string> SubmitBatch(UploadBatch& batch);
+
+    // Releases the staging memory of finished batches and records their ownership acquires into
+    // the graphics command buffer. Returns the highest ticket which is usable by that command buffer,
+    // its submission has to wait on the timeline semaphore for that value
+    uint64_t AcquireCompletedUploads(VkCommandBuffer graphicsCommandBuffer);
+
+    // Blocks until everything submitted so far has been copied
+    void WaitIdle();
+
+    VkSemaphore GetTimelineSemaphore() const;
+    bool IsOwnershipTransferRequired() const;
+
+private:
+    struct PendingUpload
+    {
+        uint64_t ticket = 0;
+        VkCommandBuffer commandBuffer = {};
+        AllocatedBuffer stagingBuffer = {};
+        std::vector<UploadRegion> regions;
+    };
+
+    VkDevice _device = {};
+    VmaAllocator _allocator = {};
+    VkQueue _transferQueue = {};
+    uint32_t _transferQueueFamily = 0;
+    uint32_t _graphicsQueueFamily = 0;
+
+    VkCommandPool _commandPool = {};
+    VkSemaphore _timelineSemaphore = {};
+    uint64_t _lastSubmittedTicket = 0;
+    uint64_t _lastAcquiredTicket = 0;
+
+    std::vector<PendingUpload> _pendingUploads;
+};
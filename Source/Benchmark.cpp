@@ -0,0 +1,295 @@
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Engine.hpp"
+
+struct BenchmarkOptions
+{
+    uint32_t frameCount = 1000;
+    uint32_t warmupFrameCount = 60;
+    bool json = false;
+    std::string outputFilePath;
+};
+
+struct MetricSamples
+{
+    std::string_view name;
+    std::vector<double> samples;
+};
+
+struct MetricSummary
+{
+    double min = 0.0;
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+
+MetricSummary Summarize(std::vector<double> samples)
+{
+    MetricSummary summary;
+    if (samples.empty())
+    {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    // nearest rank, so every reported value is an actual sample
+    auto percentile = [&](double p)
+    {
+        auto rank = static_cast<size_t>(p / 100.0 * static_cast<double>(samples.size() - 1) + 0.5);
+        return samples[std::min(rank, samples.size() - 1)];
+    };
+
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+    summary.p50 = percentile(50.0);
+    summary.p90 = percentile(90.0);
+    summary.p95 = percentile(95.0);
+    summary.p99 = percentile(99.0);
+    return summary;
+}
+
+std::string FormatCsv(const std::vector<MetricSamples>& metrics)
+{
+    std::string output = "metric,samples,min,mean,p50,p90,p95,p99,max\n";
+    for (auto& metric : metrics)
+    {
+        auto summary = Summarize(metric.samples);
+        output += std::format("{},{},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f},{:.4f}\n",
+            metric.name,
+            metric.samples.size(),
+            summary.min,
+            summary.mean,
+            summary.p50,
+            summary.p90,
+            summary.p95,
+            summary.p99,
+            summary.max);
+    }
+
+    return output;
+}
+
+std::string FormatJson(
+    const std::vector<MetricSamples>& metrics,
+    const BenchmarkOptions& benchmarkOptions,
+    const EngineOptions& engineOptions)
+{
+    std::string output = "{\n";
+    output += std::format("  \"frames\": {},\n", benchmarkOptions.frameCount);
+    output += std::format("  \"warmupFrames\": {},\n", benchmarkOptions.warmupFrameCount);
+    output += std::format("  \"sceneReplicas\": {},\n", engineOptions.sceneReplicaCount);
+    output += std::format("  \"headless\": {},\n", engineOptions.headless);
+    output += std::format("  \"frameData\": \"{}\",\n", engineOptions.frameDataPlacement == MemoryPlacement::HostVisible ? "host" : "rebar");
+    output += std::format("  \"vertexFormat\": \"{}\",\n", engineOptions.vertexFormat == VertexFormat::PackedPositionNormalUv ? "packed" : "full");
+    output += std::format("  \"optimizeGeometry\": {},\n", engineOptions.optimizeGeometry);
+    output += std::format("  \"meshCache\": {},\n", !engineOptions.meshCacheDirectory.empty());
+    output += "  \"metrics\": {\n";
+    for (size_t metricIndex = 0; metricIndex < metrics.size(); metricIndex++)
+    {
+        auto& metric = metrics[metricIndex];
+        auto summary = Summarize(metric.samples);
+        output += std::format("    \"{}\": {{ \"samples\": {}, \"min\": {:.4f}, \"mean\": {:.4f}, \"p50\": {:.4f}, \"p90\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}{}\n",
+            metric.name,
+            metric.samples.size(),
+            summary.min,
+            summary.mean,
+            summary.p50,
+            summary.p90,
+            summary.p95,
+            summary.p99,
+            summary.max,
+            metricIndex + 1 < metrics.size() ? "," : "");
+    }
+    output += "  }\n}\n";
+
+    return output;
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+    EngineOptions engineOptions;
+    engineOptions.headless = true;
+
+    BenchmarkOptions benchmarkOptions;
+
+    for (int32_t argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+    {
+        std::string_view argument = argv[argumentIndex];
+        auto hasValue = argumentIndex + 1 < argc;
+        if (argument == "--windowed")
+        {
+            engineOptions.headless = false;
+        }
+        else if (argument == "--replicas" && hasValue)
+        {
+            engineOptions.sceneReplicaCount = static_cast<uint32_t>(std::strtoul(argv[++argumentIndex], nullptr, 10));
+        }
+        else if (argument == "--frames" && hasValue)
+        {
+            benchmarkOptions.frameCount = static_cast<uint32_t>(std::strtoul(argv[++argumentIndex], nullptr, 10));
+        }
+        else if (argument == "--warmup" && hasValue)
+        {
+            benchmarkOptions.warmupFrameCount = static_cast<uint32_t>(std::strtoul(argv[++argumentIndex], nullptr, 10));
+        }
+        else if (argument == "--frame-data" && hasValue)
+        {
+            engineOptions.frameDataPlacement = std::string_view(argv[++argumentIndex]) == "host"
+                ? MemoryPlacement::HostVisible
+                : MemoryPlacement::ReBar;
+        }
+        else if (argument == "--vertex-format" && hasValue)
+        {
+            engineOptions.vertexFormat = std::string_view(argv[++argumentIndex]) == "packed"
+                ? VertexFormat::PackedPositionNormalUv
+                : VertexFormat::PositionNormalUv;
+        }
+        else if (argument == "--optimize-geometry")
+        {
+            engineOptions.optimizeGeometry = true;
+        }
+        else if (argument == "--no-mesh-cache")
+        {
+            engineOptions.meshCacheDirectory.clear();
+        }
+        else if (argument == "--format" && hasValue)
+        {
+            benchmarkOptions.json = std::string_view(argv[++argumentIndex]) == "json";
+        }
+        else if (argument == "--output" && hasValue)
+        {
+            benchmarkOptions.outputFilePath = argv[++argumentIndex];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--windowed] [--replicas <count>] [--frames <count>] [--warmup <count>] [--frame-data host|rebar] [--vertex-format full|packed] [--optimize-geometry] [--no-mesh-cache] [--format csv|json] [--output <file>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    Engine engine;
+    if (!engine.Initialize(engineOptions))
+    {
+        return EXIT_FAILURE;
+    }
+
+    auto loadStartTime = std::chrono::steady_clock::now();
+    if (!engine.Load())
+    {
+        engine.Unload();
+        return EXIT_FAILURE;
+    }
+
+    // measure the steady state, not frames which skip meshes still being uploaded
+    engine.WaitForPendingUploads();
+    auto loadTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStartTime).count();
+
+    std::vector<MetricSamples> metrics =
+    {
+        { "cpu_frame_ms", {} },
+        { "fence_wait_ms", {} },
+        { "record_ms", {} },
+        { "submit_ms", {} },
+        { "gpu_ms", {} },
+        { "upload_bytes", {} },
+    };
+
+    for (auto& metric : metrics)
+    {
+        metric.samples.reserve(benchmarkOptions.frameCount);
+    }
+
+    auto totalFrameCount = benchmarkOptions.warmupFrameCount + benchmarkOptions.frameCount;
+    uint32_t frame = 0;
+    while (frame < totalFrameCount)
+    {
+        if (!engineOptions.headless)
+        {
+            glfwPollEvents();
+        }
+
+        if (!engine.Draw())
+        {
+            engine.Unload();
+            return EXIT_FAILURE;
+        }
+
+        // Minimized or out of date, the statistics are still the previous frame's. Counts as neither warmup nor sample
+        auto& frameStatistics = engine.GetFrameStatistics();
+        if (!frameStatistics.isRendered)
+        {
+            if (engine.IsMinimized())
+            {
+                glfwWaitEvents();
+            }
+
+            continue;
+        }
+
+        if (frame++ < benchmarkOptions.warmupFrameCount)
+        {
+            continue;
+        }
+
+        metrics[0].samples.push_back(frameStatistics.cpuFrameTimeMs);
+        metrics[1].samples.push_back(frameStatistics.fenceWaitTimeMs);
+        metrics[2].samples.push_back(frameStatistics.recordTimeMs);
+        metrics[3].samples.push_back(frameStatistics.submitTimeMs);
+        metrics[4].samples.push_back(frameStatistics.gpuTimeMs);
+        metrics[5].samples.push_back(static_cast<double>(frameStatistics.uploadedBytes));
+    }
+
+    // A warm mesh cache shows here, run twice to compare against the cold load
+    metrics.push_back({ "load_ms", { loadTimeMs } });
+    // Same for a warm pipeline cache
+    metrics.push_back({ "pipeline_compile_ms", { engine.GetStartupStatistics().pipelineCompileTimeMs } });
+
+    // Simulated at load time, one sample each
+    auto& geometryStatistics = engine.GetGeometryStatistics();
+    if (geometryStatistics.triangleCount > 0)
+    {
+        auto indexCount = 3.0 * static_cast<double>(geometryStatistics.triangleCount);
+        metrics.push_back({ "vertex_cache_hit_rate_unoptimized", { 1.0 - static_cast<double>(geometryStatistics.transformedVertexCountBefore) / indexCount } });
+        metrics.push_back({ "vertex_cache_hit_rate", { 1.0 - static_cast<double>(geometryStatistics.transformedVertexCountAfter) / indexCount } });
+    }
+
+    engine.Unload();
+
+    auto output = benchmarkOptions.json
+        ? FormatJson(metrics, benchmarkOptions, engineOptions)
+        : FormatCsv(metrics);
+
+    if (benchmarkOptions.outputFilePath.empty())
+    {
+        std::cout << output;
+        return EXIT_SUCCESS;
+    }
+
+    std::ofstream file(benchmarkOptions.outputFilePath);
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to write " << benchmarkOptions.outputFilePath << "\n";
+        return EXIT_FAILURE;
+    }
+
+    file << output;
+
+    return EXIT_SUCCESS;
+}
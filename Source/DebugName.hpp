@@ -0,0 +1,26 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <string>
+
+#include "Types.hpp"
+
+// Names show up in validation messages and graphics debuggers, release builds skip them
+template<typename T>
+void SetDebugName(VkDevice device, T object, const std::string& debugName)
+{
+#ifdef _DEBUG
+    const VkDebugUtilsObjectNameInfoEXT debugUtilsObjectNameInfo =
+    {
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
+        .pNext = NULL,
+        .objectType = VulkanObjectType<T>::objectType,
+        .objectHandle = (uint64_t)object,
+        .pObjectName = debugName.c_str(),
+    };
+
+    vkSetDebugUtilsObjectNameEXT(device, &debugUtilsObjectNameInfo);
+#endif
+}
@@ -3,12 +3,23 @@
 #include "Io.hpp"
 #include "Stbi.hpp"
 #include "PipelineBuilder.hpp"
+#include "PipelineCache.hpp"
+#include "VertexConversion.hpp"
 
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <stack>
 #include <tuple>
 #include <format>
+#include <iostream>
+#include <limits>
 
+#include <glm/common.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtx/transform.hpp>
@@ -40,6 +51,11 @@ VkSurfaceKHR CreateSurface(
     return surface;
 }
 
+double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 glm::mat4 NodeToMat4(const fastgltf::Node& node)
 {
     glm::mat4 transform{1.0};
@@ -72,68 +88,319 @@ glm::mat4 NodeToMat4(const fastgltf::Node& node)
     return transform;
 }
 
-std::vector<VertexPositionNormalUv> ConvertVertexBufferFormat(const fastgltf::Asset& model, const fastgltf::Primitive& primitive)
+size_t GetVertexCount(const fastgltf::Asset& model, const fastgltf::Primitive& primitive)
+{
+    return model.accessors[primitive.findAttribute("POSITION")->second].count;
+}
+
+size_t GetIndexCount(const fastgltf::Asset& model, const fastgltf::Primitive& primitive)
+{
+    return model.accessors[primitive.indicesAccessor.value()].count;
+}
+
+// Keeps 16 bit indices and narrows 32 bit ones whenever every vertex is addressable with 16 bits.
+// 8 bit indices are widened to 16 bit, VK_INDEX_TYPE_UINT8 would need an extension
+VkIndexType GetIndexType(const fastgltf::Asset& model, const fastgltf::Primitive& primitive, size_t vertexCount)
+{
+    auto componentType = model.accessors[primitive.indicesAccessor.value()].componentType;
+    return componentType != fastgltf::ComponentType::UnsignedInt || vertexCount <= std::numeric_limits<uint16_t>::max()
+        ? VkIndexType::VK_INDEX_TYPE_UINT16
+        : VkIndexType::VK_INDEX_TYPE_UINT32;
+}
+
+// Goes through fastgltf element by element, for accessors the conversion kernels can not read directly
+void DecodeVerticesGeneric(
+    const fastgltf::Asset& model,
+    const fastgltf::Primitive& primitive,
+    VertexPositionNormalUv* vertices,
+    glm::vec3& boundsMin,
+    glm::vec3& boundsMax)
 {
-    std::vector<glm::vec3> positions;
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
     auto& positionAccessor = model.accessors[primitive.findAttribute("POSITION")->second];
-    positions.resize(positionAccessor.count);
-    fastgltf::iterateAccessorWithIndex<glm::vec3>(model,
-                                                  positionAccessor,
-                                                  [&](glm::vec3 position, std::size_t idx) { positions[idx] = position; });
+    fastgltf::iterateAccessorWithIndex<glm::vec3>(model, positionAccessor, [&](glm::vec3 position, std::size_t idx)
+    {
+        vertices[idx].position = position;
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+    });
 
-    std::vector<glm::vec3> normals;
-    auto& normalAccessor = model.accessors[primitive.findAttribute("NORMAL")->second];
-    normals.resize(normalAccessor.count);
-    fastgltf::iterateAccessorWithIndex<glm::vec3>(model,
-                                                  normalAccessor,
-                                                  [&](glm::vec3 normal, std::size_t idx) { normals[idx] = normal; });
+    if (positionAccessor.count == 0)
+    {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+    }
 
-    std::vector<glm::vec2> texcoords;
+    auto normalAttribute = primitive.findAttribute("NORMAL");
+    if (normalAttribute != primitive.attributes.end())
+    {
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(model, model.accessors[normalAttribute->second], [&](glm::vec3 normal, std::size_t idx)
+        {
+            vertices[idx].normal = normal;
+        });
+    }
+    else
+    {
+        for (size_t i = 0; i < positionAccessor.count; i++)
+        {
+            vertices[i].normal = glm::vec3(0.0f);
+        }
+    }
 
     // Textureless meshes will use factors instead of textures
-    if (primitive.findAttribute("TEXCOORD_0") != primitive.attributes.end())
+    auto texcoordAttribute = primitive.findAttribute("TEXCOORD_0");
+    if (texcoordAttribute != primitive.attributes.end())
     {
-        auto& texcoordAccessor = model.accessors[primitive.findAttribute("TEXCOORD_0")->second];
-        texcoords.resize(texcoordAccessor.count);
-        fastgltf::iterateAccessorWithIndex<glm::vec2>(model,
-                                                    texcoordAccessor,
-                                                    [&](glm::vec2 texcoord, std::size_t idx)
-                                                    { texcoords[idx] = texcoord; });
+        fastgltf::iterateAccessorWithIndex<glm::vec2>(model, model.accessors[texcoordAttribute->second], [&](glm::vec2 texcoord, std::size_t idx)
+        {
+            vertices[idx].uv = texcoord;
+        });
     }
     else
     {
         // If no texcoord attribute, fill with empty texcoords to keep everything consistent and happy
-        texcoords.resize(positions.size(), {});
+        for (size_t i = 0; i < positionAccessor.count; i++)
+        {
+            vertices[i].uv = glm::vec2(0.0f);
+        }
     }
+}
+
+// Replaces the files buffers refer to by mappings of them. Accessors read them in place then, and only
+// the pages they touch are read from disk. Images are left alone, nothing here decodes them
+bool MapExternalSources(fastgltf::Asset& model, const std::filesystem::path& directory, std::vector<MappedFile>& mappedFiles)
+{
+    auto mapSource = [&](fastgltf::DataSource& dataSource)
+    {
+        auto* uri = std::get_if<fastgltf::sources::URI>(&dataSource);
+        if (uri == nullptr || !uri->uri.isLocalPath())
+        {
+            return true;
+        }
+
+        auto mappedFileResult = MappedFile::Open(directory / uri->uri.fspath());
+        if (!mappedFileResult.has_value())
+        {
+            std::cerr << mappedFileResult.error() << "\n";
+            return false;
+        }
+
+        auto& mappedFile = mappedFiles.emplace_back(std::move(mappedFileResult.value()));
+        auto bytes = mappedFile.GetBytes().subspan(std::min(uri->fileByteOffset, mappedFile.GetSize()));
+
+        fastgltf::sources::ByteView byteView;
+        byteView.bytes = fastgltf::span<const std::byte>(bytes.data(), bytes.size());
+        byteView.mimeType = uri->mimeType;
+        dataSource = byteView;
 
-    std::vector<VertexPositionNormalUv> vertices;
-    vertices.resize(positions.size());
+        return true;
+    };
 
-    for (size_t i = 0; i < positions.size(); i++)
+    for (auto& buffer : model.buffers)
     {
-        vertices[i] = 
+        if (!mapSource(buffer.data))
         {
-            positions[i],
-            normals[i],
-            texcoords[i]
-        };
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Pointer to the first element of the accessor, nullptr when its bytes can not be read in place because
+// it is sparse, has no buffer view or its buffer was not loaded into memory
+const std::byte* GetAccessorData(const fastgltf::Asset& model, const fastgltf::Accessor& accessor, size_t& byteStride)
+{
+    if (!accessor.bufferViewIndex.has_value() || accessor.sparse.has_value())
+    {
+        return nullptr;
+    }
+
+    auto& bufferView = model.bufferViews[accessor.bufferViewIndex.value()];
+    auto& buffer = model.buffers[bufferView.bufferIndex];
+
+    const std::byte* bufferData = nullptr;
+    if (auto* vector = std::get_if<fastgltf::sources::Vector>(&buffer.data))
+    {
+        bufferData = reinterpret_cast<const std::byte*>(vector->bytes.data());
+    }
+    else if (auto* byteView = std::get_if<fastgltf::sources::ByteView>(&buffer.data))
+    {
+        bufferData = byteView->bytes.data();
+    }
+
+    if (bufferData == nullptr)
+    {
+        return nullptr;
     }
 
-    return vertices;
+    byteStride = bufferView.byteStride.value_or(fastgltf::getElementByteSize(accessor.type, accessor.componentType));
+    return bufferData + bufferView.byteOffset + accessor.byteOffset;
 }
 
-std::vector<uint32_t> ConvertIndexBufferFormat(
+// The accessor's elements as floats. Quantized components (KHR_mesh_quantization) are converted into scratch
+// first, keeping the element layout so byteStride stays meaningful
+const std::byte* GetFloatAccessorData(
     const fastgltf::Asset& model,
-    const fastgltf::Primitive& primitive)
+    const fastgltf::Accessor& accessor,
+    std::vector<float>& scratch,
+    size_t& byteStride)
+{
+    auto* data = GetAccessorData(model, accessor, byteStride);
+    if (data == nullptr || accessor.count == 0 || accessor.componentType == fastgltf::ComponentType::Float)
+    {
+        return data;
+    }
+
+    auto componentStride = byteStride / (fastgltf::getComponentBitSize(accessor.componentType) / 8);
+    auto componentCount = (accessor.count - 1) * componentStride + fastgltf::getNumComponents(accessor.type);
+    scratch.resize(componentCount);
+
+    switch (accessor.componentType)
+    {
+        case fastgltf::ComponentType::Byte:
+            ConvertComponentsToFloat(reinterpret_cast<const int8_t*>(data), scratch.data(), componentCount, accessor.normalized);
+            break;
+        case fastgltf::ComponentType::UnsignedByte:
+            ConvertComponentsToFloat(reinterpret_cast<const uint8_t*>(data), scratch.data(), componentCount, accessor.normalized);
+            break;
+        case fastgltf::ComponentType::Short:
+            ConvertComponentsToFloat(reinterpret_cast<const int16_t*>(data), scratch.data(), componentCount, accessor.normalized);
+            break;
+        case fastgltf::ComponentType::UnsignedShort:
+            ConvertComponentsToFloat(reinterpret_cast<const uint16_t*>(data), scratch.data(), componentCount, accessor.normalized);
+            break;
+        default:
+            return nullptr;
+    }
+
+    byteStride = componentStride * sizeof(float);
+    return reinterpret_cast<const std::byte*>(scratch.data());
+}
+
+// Decodes every attribute straight into its field of the interleaved vertex, vertices has to hold
+// GetVertexCount elements. Vertices may point into write combined staging memory, so it is written
+// but never read from
+void DecodeVertices(
+    const fastgltf::Asset& model,
+    const fastgltf::Primitive& primitive,
+    VertexPositionNormalUv* vertices,
+    glm::vec3& boundsMin,
+    glm::vec3& boundsMax)
+{
+    auto& positionAccessor = model.accessors[primitive.findAttribute("POSITION")->second];
+    auto normalAttribute = primitive.findAttribute("NORMAL");
+    auto texcoordAttribute = primitive.findAttribute("TEXCOORD_0");
+
+    std::vector<float> positionScratch;
+    std::vector<float> normalScratch;
+    std::vector<float> uvScratch;
+    size_t positionStride = 0;
+    size_t normalStride = 0;
+    size_t uvStride = 0;
+
+    auto* positions = GetFloatAccessorData(model, positionAccessor, positionScratch, positionStride);
+    auto canInterleave = positions != nullptr;
+
+    const std::byte* normals = nullptr;
+    if (normalAttribute != primitive.attributes.end())
+    {
+        normals = GetFloatAccessorData(model, model.accessors[normalAttribute->second], normalScratch, normalStride);
+        canInterleave = canInterleave && normals != nullptr;
+    }
+
+    const std::byte* uvs = nullptr;
+    if (texcoordAttribute != primitive.attributes.end())
+    {
+        uvs = GetFloatAccessorData(model, model.accessors[texcoordAttribute->second], uvScratch, uvStride);
+        canInterleave = canInterleave && uvs != nullptr;
+    }
+
+    if (!canInterleave)
+    {
+        DecodeVerticesGeneric(model, primitive, vertices, boundsMin, boundsMax);
+        return;
+    }
+
+    InterleavePositionNormalUv(
+        positions,
+        positionStride,
+        normals,
+        normalStride,
+        uvs,
+        uvStride,
+        positionAccessor.count,
+        vertices,
+        boundsMin,
+        boundsMax);
+}
+
+// indices has to hold GetIndexCount elements
+void DecodeIndices(
+    const fastgltf::Asset& model,
+    const fastgltf::Primitive& primitive,
+    uint32_t* indices)
 {
-    auto indices = std::vector<uint32_t>();
     auto& accessor = model.accessors[primitive.indicesAccessor.value()];
-    indices.resize(accessor.count);
+
+    size_t byteStride = 0;
+    if (auto* data = GetAccessorData(model, accessor, byteStride); data != nullptr)
+    {
+        switch (accessor.componentType)
+        {
+            case fastgltf::ComponentType::UnsignedByte:
+                WidenIndices(reinterpret_cast<const uint8_t*>(data), indices, accessor.count);
+                return;
+            case fastgltf::ComponentType::UnsignedShort:
+                WidenIndices(reinterpret_cast<const uint16_t*>(data), indices, accessor.count);
+                return;
+            case fastgltf::ComponentType::UnsignedInt:
+                std::memcpy(indices, data, accessor.count * sizeof(uint32_t));
+                return;
+            default:
+                break;
+        }
+    }
+
     fastgltf::iterateAccessorWithIndex<uint32_t>(model, accessor, [&](uint32_t index, size_t idx)
     {
         indices[idx] = index;
     });
-    return indices;
+}
+
+// indices has to hold GetIndexCount elements, and GetIndexType has to have picked 16 bit
+void DecodeIndices(
+    const fastgltf::Asset& model,
+    const fastgltf::Primitive& primitive,
+    uint16_t* indices)
+{
+    auto& accessor = model.accessors[primitive.indicesAccessor.value()];
+
+    size_t byteStride = 0;
+    if (auto* data = GetAccessorData(model, accessor, byteStride); data != nullptr)
+    {
+        switch (accessor.componentType)
+        {
+            case fastgltf::ComponentType::UnsignedByte:
+                WidenIndices(reinterpret_cast<const uint8_t*>(data), indices, accessor.count);
+                return;
+            case fastgltf::ComponentType::UnsignedShort:
+                std::memcpy(indices, data, accessor.count * sizeof(uint16_t));
+                return;
+            case fastgltf::ComponentType::UnsignedInt:
+                NarrowIndices(reinterpret_cast<const uint32_t*>(data), indices, accessor.count);
+                return;
+            default:
+                break;
+        }
+    }
+
+    fastgltf::iterateAccessorWithIndex<uint32_t>(model, accessor, [&](uint32_t index, size_t idx)
+    {
+        indices[idx] = static_cast<uint16_t>(index);
+    });
 }
 
 std::expected<AllocatedImage, std::string> Engine::CreateImage(
@@ -141,7 +408,8 @@ std::expected<AllocatedImage, std::string> Engine::CreateImage(
     VkFormat format,
     VkImageUsageFlags imageUsageFlags,
     VkImageAspectFlags imageAspectFlags,
-    VkExtent3D extent)
+    VkExtent3D extent,
+    bool isOwnedByDeletionQueue)
 {
     AllocatedImage image;
     if (vmaCreateImage(
@@ -200,69 +468,59 @@ std::expected<AllocatedImage, std::string> Engine::CreateImage(
     auto viewLabel = std::format("{}_ImageView", label);
     SetDebugName(_device, image.imageView, viewLabel);
 
-    _deletionQueue.Push([=, this]()
+    if (isOwnedByDeletionQueue)
     {
-        vkDestroyImageView(_device, image.imageView, nullptr);
-        vmaDestroyImage(_allocator, image.image, image.allocation);
-    });
+        _deletionQueue.Push([=, this]()
+        {
+            DestroyImage(image);
+        });
+    }
 
     return image;
 }
 
-bool Engine::Initialize()
+void Engine::DestroyImage(const AllocatedImage& image)
 {
-    if (!glfwInit())
-    {
-        std::cout << "GLFW: Unable to initialize\n";
-        return false;
-    }
-
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-
-    auto primaryMonitor = glfwGetPrimaryMonitor();
-    auto videoMode = glfwGetVideoMode(primaryMonitor);
-
-    auto screenWidth = videoMode->width;
-    auto screenHeight = videoMode->height;
-
-    auto windowWidth = static_cast<int32_t>(static_cast<float>(screenWidth) * 0.8f);
-    auto windowHeight = static_cast<int32_t>(static_cast<float>(screenHeight) * 0.8f);
-
-    _windowExtent.width = windowWidth;
-    _windowExtent.height = windowHeight;
+    vkDestroyImageView(_device, image.imageView, nullptr);
+    vmaDestroyImage(_allocator, image.image, image.allocation);
+}
 
-    _window = glfwCreateWindow(windowWidth, windowHeight, _windowTitle.data(), nullptr, nullptr);
-    if (_window == nullptr)
+bool Engine::Initialize(const EngineOptions& options)
+{
+    _headless = options.headless;
+    _sceneReplicaCount = options.sceneReplicaCount;
+    _geometryPoolVertexCapacity = options.geometryPoolVertexCapacity;
+    _geometryPoolIndexCapacity = options.geometryPoolIndexCapacity;
+    _frameDataPlacement = options.frameDataPlacement;
+    _keepCpuGeometry = options.keepCpuGeometry;
+    _vertexFormat = options.vertexFormat;
+    _optimizeGeometry = options.optimizeGeometry;
+    _meshCacheDirectory = options.meshCacheDirectory;
+    _pipelineCachePath = options.pipelineCachePath;
+    _optimizePipelinesInBackground = options.optimizePipelinesInBackground;
+    _workerThreadCount = options.workerThreadCount;
+    if (_headless)
+    {
+        _windowExtent = options.headlessExtent;
+    }
+    else if (!InitializeWindow())
     {
-        std::cout << "GLFW: Unable to create window\n";
-        glfwTerminate();
         return false;
     }
 
-    int32_t monitorLeft = 0;
-    int32_t monitorTop = 0;
-    glfwGetMonitorPos(primaryMonitor, &monitorLeft, &monitorTop);
-    glfwSetWindowPos(_window, screenWidth / 2 - windowWidth / 2 + monitorLeft, screenHeight / 2 - windowHeight / 2 + monitorTop);
-
-    int32_t appImageWidth{};
-    int32_t appImageHeight{};
-    unsigned char* appImagePixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(&AppIcon[0]), AppIcon_length, &appImageWidth, &appImageHeight, nullptr, 4);
-    if (appImagePixels != nullptr)
-    {
-        GLFWimage appImage{};
-        appImage.width = appImageWidth;
-        appImage.height = appImageHeight;
-        appImage.pixels = appImagePixels;
-        glfwSetWindowIcon(_window, 1, &appImage);
-        stbi_image_free(appImagePixels);
-    }    
-
     if (!InitializeVulkan())
     {
         return false;
     }
 
-    if (!InitializeSwapchain())
+    if (_headless)
+    {
+        if (!InitializeOffscreenTargets())
+        {
+            return false;
+        }
+    }
+    else if (!InitializeSwapchain())
     {
         return false;
     }
@@ -277,27 +535,11 @@ bool Engine::Initialize()
         return false;
     }
 
-    VkExtent3D depthImageExtent =
-    {
-        .width = _windowExtent.width,
-        .height = _windowExtent.height,
-        .depth = 1
-    };
-
-    auto depthImageResult = CreateImage(
-        "DepthImage",
-        _depthFormat,
-        VkImageUsageFlagBits::VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-        VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT,
-        depthImageExtent);
-    if (!depthImageResult.has_value())
+    if (!InitializeDepthImage())
     {
-        std::cerr << depthImageResult.error();
         return false;
     }
 
-    _depthImage = depthImageResult.value();
-
     if (!InitializeFramebuffers())
     {
         return false;
@@ -313,127 +555,249 @@ bool Engine::Initialize()
         return false;
     }
 
-    return true;
-}
-
-bool Engine::Load()
-{
-    auto loadShaderModuleResult = LoadShaderModule("data/shaders/Simple.vs.glsl.spv");
-    if (!loadShaderModuleResult.has_value())
+    if (!InitializeProfiler())
     {
-        std::cout << loadShaderModuleResult.error();
         return false;
     }
 
-    _simpleVertexShaderModule = loadShaderModuleResult.value();
-
-    loadShaderModuleResult = LoadShaderModule("data/shaders/Simple.fs.glsl.spv");
-    if (!loadShaderModuleResult.has_value())
+    if (!InitializeGeometryPool())
     {
-        std::cout << loadShaderModuleResult.error();
         return false;
     }
 
-    _simpleFragmentShaderModule = loadShaderModuleResult.value();
-
-    VkViewport viewport =
+    if (!InitializeAsyncUploader())
     {
-        .x = 0,
-        .y = (float)_windowExtent.height,
-        .width = (float)_windowExtent.width,
-        .height = -(float)_windowExtent.height,
-        .minDepth = 0.0f,
-        .maxDepth = 1.0f
-    };
-    VkRect2D scissor =
+        return false;
+    }
+
+    if (!InitializeJobSystem())
     {
-        .offset = { 0, 0 },
-        .extent = _windowExtent
-    };
+        return false;
+    }
 
-    PipelineBuilder pipelineBuilder(_deletionQueue);
-    auto pipelineResult = pipelineBuilder
-        .WithGraphicsShadingStages(_simpleVertexShaderModule, _simpleFragmentShaderModule)
-        .WithVertexInput(VertexPositionNormalUv::GetVertexInputDescription())
-        .WithTopology(VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
-        .WithPolygonMode(VkPolygonMode::VK_POLYGON_MODE_FILL)
-        .WithViewportAndScissor(viewport, scissor)     
-        .WithDepthTestingEnabled(VkCompareOp::VK_COMPARE_OP_LESS)
-        .WithoutBlending()
-        .WithoutMultisampling()
-        .WithDescriptorSetLayout(_globalDescriptorSetLayout)
-        .WithDescriptorSetLayout(_objectDescriptorSetLayout)
-        .Build("OpaquePipeline", _device, _renderPass);
-    if (!pipelineResult.has_value())
+    if (!InitializePipelineCache())
     {
-        std::cout << pipelineResult.error();
         return false;
     }
 
-    if (!LoadMeshFromFile("SM_Cubes", "data/models/deccer-cubes/SM_Deccer_Cubes_Textured_Complex.gltf"))
+    if (!InitializePipelineLibraryCache())
     {
         return false;
     }
 
-    auto meshes = GetModel("SM_Cubes");
-    auto meshIndex = 0;
-    auto originTransform = glm::translate(glm::mat4(1.0f), glm::vec3(-20.0f, 0.0f, 0.0f));
-    for (size_t i = 0; i < 3; i++)
+    if (!InitializePipelineCompiler())
     {
-        auto rootTransform = glm::translate(originTransform, glm::vec3(meshIndex * 10.0f, 0.0f, 0.0f));    
-        for (auto& mesh : meshes)
-        {
-            Renderable renderable;
-            renderable.pipeline = pipelineResult.value();
-            renderable.mesh = mesh;
-            renderable.worldMatrix = rootTransform * mesh->worldMatrix;
-            _renderables.push_back(renderable);
-        }
-        meshIndex++;        
+        return false;
     }
 
     return true;
 }
 
-bool Engine::LoadMeshFromFile(const std::string& modelName, const std::string& filePath)
+bool Engine::InitializeWindow()
 {
-    fastgltf::Parser parser(fastgltf::Extensions::KHR_mesh_quantization);
+    if (!glfwInit())
+    {
+        std::cout << "GLFW: Unable to initialize\n";
+        return false;
+    }
 
-    auto path = std::filesystem::path{filePath};
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-    constexpr auto gltfOptions =
-        fastgltf::Options::DontRequireValidAssetMember |
-        fastgltf::Options::AllowDouble |
-        fastgltf::Options::LoadGLBBuffers |
-        fastgltf::Options::LoadExternalBuffers |
-        fastgltf::Options::LoadExternalImages;
+    auto primaryMonitor = glfwGetPrimaryMonitor();
+    auto videoMode = glfwGetVideoMode(primaryMonitor);
 
-    fastgltf::GltfDataBuffer data;
-    data.loadFromFile(path);
+    auto screenWidth = videoMode->width;
+    auto screenHeight = videoMode->height;
 
-    auto gltfType = fastgltf::determineGltfFileType(&data);
-    fastgltf::Expected<fastgltf::Asset> assetResult(fastgltf::Error::None);
-    if (gltfType == fastgltf::GltfType::glTF)
-    {
-        assetResult = parser.loadGLTF(&data, path.parent_path(), gltfOptions);
-    } 
-    else if (gltfType == fastgltf::GltfType::GLB)
-    {
-        assetResult = parser.loadBinaryGLTF(&data, path.parent_path(), gltfOptions);
-    }
-    else
+    auto windowWidth = static_cast<int32_t>(static_cast<float>(screenWidth) * 0.8f);
+    auto windowHeight = static_cast<int32_t>(static_cast<float>(screenHeight) * 0.8f);
+
+    _windowExtent.width = windowWidth;
+    _windowExtent.height = windowHeight;
+
+    _window = glfwCreateWindow(windowWidth, windowHeight, _windowTitle.data(), nullptr, nullptr);
+    if (_window == nullptr)
     {
-        std::cerr << "fastgltf: Failed to determine glTF container\n";
+        std::cout << "GLFW: Unable to create window\n";
+        glfwTerminate();
         return false;
     }
 
-    if (assetResult.error() != fastgltf::Error::None)
+    int32_t monitorLeft = 0;
+    int32_t monitorTop = 0;
+    glfwGetMonitorPos(primaryMonitor, &monitorLeft, &monitorTop);
+    glfwSetWindowPos(_window, screenWidth / 2 - windowWidth / 2 + monitorLeft, screenHeight / 2 - windowHeight / 2 + monitorTop);
+
+    int32_t appImageWidth{};
+    int32_t appImageHeight{};
+    unsigned char* appImagePixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(&AppIcon[0]), AppIcon_length, &appImageWidth, &appImageHeight, nullptr, 4);
+    if (appImagePixels != nullptr)
+    {
+        GLFWimage appImage{};
+        appImage.width = appImageWidth;
+        appImage.height = appImageHeight;
+        appImage.pixels = appImagePixels;
+        glfwSetWindowIcon(_window, 1, &appImage);
+        stbi_image_free(appImagePixels);
+    }    
+
+    glfwSetWindowUserPointer(_window, this);
+    glfwSetFramebufferSizeCallback(_window, [](GLFWwindow* window, int32_t, int32_t)
+    {
+        // Some platforms never report VK_ERROR_OUT_OF_DATE_KHR on resize
+        auto engine = static_cast<Engine*>(glfwGetWindowUserPointer(window));
+        engine->_isSwapchainOutOfDate = true;
+    });
+
+    return true;
+}
+
+bool Engine::Load()
+{
+    // The packed vertex format has its own vertex shader, decoding normals
+    auto isVertexFormatPacked = _vertexFormat == VertexFormat::PackedPositionNormalUv;
+    auto loadShaderModuleResult = LoadShaderModule(isVertexFormatPacked
+        ? "data/shaders/SimplePacked.vs.glsl.spv"
+        : "data/shaders/Simple.vs.glsl.spv");
+    if (!loadShaderModuleResult.has_value())
+    {
+        std::cout << loadShaderModuleResult.error();
+        return false;
+    }
+
+    _simpleVertexShaderModule = loadShaderModuleResult.value();
+
+    loadShaderModuleResult = LoadShaderModule("data/shaders/Simple.fs.glsl.spv");
+    if (!loadShaderModuleResult.has_value())
+    {
+        std::cout << loadShaderModuleResult.error();
+        return false;
+    }
+
+    _simpleFragmentShaderModule = loadShaderModuleResult.value();
+
+    PipelineBuilder pipelineBuilder;
+    pipelineBuilder
+        .WithGraphicsShadingStages(_simpleVertexShaderModule, _simpleFragmentShaderModule)
+        .WithVertexInput(isVertexFormatPacked
+            ? VertexPackedPositionNormalUv::GetVertexInputDescription()
+            : VertexPositionNormalUv::GetVertexInputDescription())
+        .WithTopology(VkPrimitiveTopology::VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST)
+        .WithPolygonMode(VkPolygonMode::VK_POLYGON_MODE_FILL)
+        .WithDynamicViewportAndScissor()
+        .WithDepthTestingEnabled(VkCompareOp::VK_COMPARE_OP_LESS)
+        .WithoutBlending()
+        .WithoutMultisampling()
+        .WithDescriptorSetLayout(_globalDescriptorSetLayout)
+        .WithDescriptorSetLayout(_objectDescriptorSetLayout);
+
+    // Compiles alongside the model load, renderables using it are skipped until it is ready
+    _meshPipeline = _pipelineCompiler.Request("OpaquePipeline", pipelineBuilder, _renderPass);
+
+    // Frames render right away, the replicas are laid out once the model streamed in
+    RequestModel("SM_Cubes", "data/models/deccer-cubes/SM_Deccer_Cubes_Textured_Complex.gltf", [this](const std::string& modelName)
+    {
+        auto meshes = GetModel(modelName);
+        auto meshIndex = 0;
+        auto originTransform = glm::translate(glm::mat4(1.0f), glm::vec3(-20.0f, 0.0f, 0.0f));
+        for (size_t i = 0; i < _sceneReplicaCount; i++)
+        {
+            // rows of 8 copies, growing away from the camera
+            auto rootTransform = glm::translate(originTransform, glm::vec3((meshIndex % 8) * 10.0f, 0.0f, (meshIndex / 8) * -10.0f));
+            for (auto& mesh : meshes)
+            {
+                Renderable renderable;
+                renderable.pipeline = _meshPipeline;
+                renderable.mesh = mesh;
+                renderable.worldMatrix = rootTransform * mesh->worldMatrix;
+                _renderables.push_back(renderable);
+            }
+            meshIndex++;
+        }
+    });
+
+    return true;
+}
+
+bool Engine::LoadMeshFromFile(const std::string& filePath, StreamedModel& streamedModel)
+{
+    ZoneScoped;
+
+    auto path = std::filesystem::path{filePath};
+
+    // A warm start skips parsing, decoding and optimizing, the cached blobs are already what the GPU gets
+    auto isMeshCacheUsed = !_meshCacheDirectory.empty() && !_keepCpuGeometry;
+    auto meshCachePath = GetMeshCachePath(_meshCacheDirectory, path);
+    if (isMeshCacheUsed)
+    {
+        auto meshCacheResult = ReadMeshCache(meshCachePath, path, _vertexFormat, _optimizeGeometry);
+        if (meshCacheResult.has_value())
+        {
+            return LoadMeshFromCache(meshCachePath, meshCacheResult.value(), streamedModel);
+        }
+    }
+
+    fastgltf::Parser parser(fastgltf::Extensions::KHR_mesh_quantization);
+
+    // External buffers and images are mapped below instead of being read into memory by fastgltf
+    constexpr auto gltfOptions =
+        fastgltf::Options::DontRequireValidAssetMember |
+        fastgltf::Options::AllowDouble |
+        fastgltf::Options::LoadGLBBuffers;
+
+    // Accessors point straight into these mappings, they have to outlive decoding
+    std::vector<MappedFile> mappedFiles;
+    auto gltfFileResult = MappedFile::Open(path);
+    if (!gltfFileResult.has_value())
+    {
+        std::cerr << gltfFileResult.error() << "\n";
+        return false;
+    }
+
+    auto& gltfFile = mappedFiles.emplace_back(std::move(gltfFileResult.value()));
+
+    // simdjson reads up to getGltfBufferPadding bytes past the end, the zeroed rest of the last mapped page
+    // usually covers that. The parser never writes to the buffer
+    fastgltf::GltfDataBuffer data;
+    if (gltfFile.GetMappedSize() - gltfFile.GetSize() >= fastgltf::getGltfBufferPadding())
+    {
+        data.fromByteView(
+            const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(gltfFile.GetData())),
+            gltfFile.GetSize(),
+            gltfFile.GetMappedSize());
+    }
+    else
+    {
+        data.copyBytes(reinterpret_cast<const uint8_t*>(gltfFile.GetData()), gltfFile.GetSize());
+    }
+
+    auto gltfType = fastgltf::determineGltfFileType(&data);
+    fastgltf::Expected<fastgltf::Asset> assetResult(fastgltf::Error::None);
+    if (gltfType == fastgltf::GltfType::glTF)
+    {
+        assetResult = parser.loadGLTF(&data, path.parent_path(), gltfOptions);
+    } 
+    else if (gltfType == fastgltf::GltfType::GLB)
+    {
+        assetResult = parser.loadBinaryGLTF(&data, path.parent_path(), gltfOptions);
+    }
+    else
+    {
+        std::cerr << "fastgltf: Failed to determine glTF container\n";
+        return false;
+    }
+
+    if (assetResult.error() != fastgltf::Error::None)
     {
         std::cerr << "fastgltf: Failed to load glTF: " << fastgltf::getErrorMessage(assetResult.error()) << "\n";
         return false;
     }
 
     auto& asset = assetResult.get();
+    if (!MapExternalSources(asset, path.parent_path(), mappedFiles))
+    {
+        return false;
+    }
 
     std::stack<std::pair<const fastgltf::Node*, glm::mat4>> nodeStack;
     glm::mat4 rootTransform = glm::mat4(1.0f);
@@ -443,8 +807,18 @@ bool Engine::LoadMeshFromFile(const std::string& modelName, const std::string& f
         nodeStack.emplace(&asset.nodes[nodeIndex], rootTransform);
     }
 
-    std::vector<std::string> meshNames;
-    
+    // The node walk only collects primitives, decoding them is fanned out across the job system
+    struct PrimitiveToLoad
+    {
+        const fastgltf::Primitive* primitive;
+        const fastgltf::Mesh* mesh;
+        const fastgltf::Node* node;
+        glm::mat4 worldMatrix;
+        // Identifies the primitive in the GeometryOptimizationCache
+        std::string optimizationKey;
+    };
+    std::vector<PrimitiveToLoad> primitivesToLoad;
+
     while (!nodeStack.empty())
     {
         decltype(nodeStack)::value_type top = nodeStack.top();
@@ -461,97 +835,508 @@ bool Engine::LoadMeshFromFile(const std::string& modelName, const std::string& f
 
         if (node->meshIndex.has_value())
         {
-            for (const fastgltf::Mesh& fgMesh = asset.meshes[node->meshIndex.value()];
-                 const auto& primitive : fgMesh.primitives)
+            const fastgltf::Mesh& fgMesh = asset.meshes[node->meshIndex.value()];
+            for (size_t primitiveIndex = 0; primitiveIndex < fgMesh.primitives.size(); primitiveIndex++)
             {
-                Mesh mesh;
-                mesh.vertices = ConvertVertexBufferFormat(asset, primitive);
-                mesh.indices = ConvertIndexBufferFormat(asset, primitive);
-                mesh.worldMatrix = globalTransform;
-                mesh.name = fgMesh.name;
-                
-                auto createStagingBufferResult = CreateStagingBuffer(std::span(mesh.vertices));
-                if (!createStagingBufferResult.has_value())
+                primitivesToLoad.push_back(PrimitiveToLoad
                 {
-                    std::cerr << createStagingBufferResult.error() << "\n";
-                    return false;
-                }
+                    .primitive = &fgMesh.primitives[primitiveIndex],
+                    .mesh = &fgMesh,
+                    .node = node,
+                    .worldMatrix = globalTransform,
+                    .optimizationKey = std::format("{}#{}#{}", filePath, node->meshIndex.value(), primitiveIndex)
+                });
+            }
+        }
+    }
 
-                auto bufferSize = createStagingBufferResult.value().bufferSize;
-                auto createBufferResult = CreateBuffer<VertexPositionNormalUv>(
-                    std::format("VertexBuffer_{}", node->name),
-                    bufferSize,
-                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
-                if (!createBufferResult.has_value())
+    // Sizes come straight from the accessors, so geometry pool ranges and staging space are known
+    // before anything is decoded. Allocated in node walk order, the layout does not depend on timing.
+    // The pool is locked while the model's ranges are allocated, so they are consecutive even while
+    // others load, decoding runs unlocked. A model failing past that point keeps its ranges, the pool
+    // only bumps and others may have allocated behind them
+    auto& loadedMeshes = streamedModel.meshes;
+    loadedMeshes.resize(primitivesToLoad.size());
+    std::vector<GeometryRange> geometryRanges(primitivesToLoad.size());
+    auto vertexStride = GetVertexStride(_vertexFormat);
+    VkDeviceSize vertexDataSize = 0;
+    VkDeviceSize indexDataSize = 0;
+    std::unique_lock geometryPoolLock(_geometryPoolMutex);
+    auto poolVertexCount = _geometryPool.GetVertexCount();
+    auto poolIndexByteCount = _geometryPool.GetIndexByteCount();
+    for (size_t primitiveIndex = 0; primitiveIndex < primitivesToLoad.size(); primitiveIndex++)
+    {
+        auto& primitiveToLoad = primitivesToLoad[primitiveIndex];
+        auto& [meshName, mesh] = loadedMeshes[primitiveIndex];
+        meshName = primitiveToLoad.node->name.c_str();
+        mesh.worldMatrix = primitiveToLoad.worldMatrix;
+        mesh.name = primitiveToLoad.mesh->name;
+        mesh.vertexFormat = _vertexFormat;
+        mesh.vertexCount = static_cast<uint32_t>(GetVertexCount(asset, *primitiveToLoad.primitive));
+        mesh.indexCount = static_cast<uint32_t>(GetIndexCount(asset, *primitiveToLoad.primitive));
+        mesh.indexType = GetIndexType(asset, *primitiveToLoad.primitive, mesh.vertexCount);
+
+        auto geometryRangeResult = _geometryPool.Allocate(mesh.vertexCount, mesh.indexCount, mesh.indexType);
+        if (!geometryRangeResult.has_value())
+        {
+            std::cerr << geometryRangeResult.error() << "\n";
+            _geometryPool.Rewind(poolVertexCount, poolIndexByteCount);
+            return false;
+        }
+
+        mesh.firstIndex = geometryRangeResult.value().firstIndex;
+        mesh.vertexOffset = geometryRangeResult.value().vertexOffset;
+        geometryRanges[primitiveIndex] = geometryRangeResult.value();
+
+        vertexDataSize += mesh.vertexCount * vertexStride;
+        indexDataSize += geometryRangeResult.value().indexByteSize;
+    }
+    geometryPoolLock.unlock();
+
+    // The whole model goes through one staging allocation and one submit on the transfer queue,
+    // vertices first and indices second so neighbouring meshes collapse into a single copy region.
+    // Primitives are decoded in parallel straight into their spot in the staging buffer.
+    // The main thread submits the batch once the model is committed, Draw skips the meshes until
+    // the copy completed
+    std::vector<std::byte> cookedVertexData;
+    std::vector<std::byte> cookedIndexData;
+    std::pair<size_t, size_t> modelTransformedVertexCounts = {0, 0};
+    if (vertexDataSize + indexDataSize > 0)
+    {
+        auto uploadBatchResult = _asyncUploader.BeginBatch(vertexDataSize + indexDataSize);
+        if (!uploadBatchResult.has_value())
+        {
+            std::cerr << uploadBatchResult.error() << "\n";
+            return false;
+        }
+
+        auto& uploadBatch = uploadBatchResult.value();
+
+        std::vector<std::pair<size_t, size_t>> transformedVertexCounts(loadedMeshes.size());
+
+        std::vector<void*> stagedVertices(loadedMeshes.size());
+        for (size_t meshIndex = 0; meshIndex < loadedMeshes.size(); meshIndex++)
+        {
+            auto& mesh = loadedMeshes[meshIndex].second;
+            stagedVertices[meshIndex] = _asyncUploader.Reserve(
+                uploadBatch,
+                _geometryPool.GetVertexBuffer().buffer,
+                static_cast<VkDeviceSize>(mesh.vertexOffset) * vertexStride,
+                mesh.vertexCount * vertexStride);
+        }
+
+        // Index ranges are padded to 4 bytes, so 16 and 32 bit meshes still form one contiguous region
+        std::vector<void*> stagedIndices(loadedMeshes.size());
+        for (size_t meshIndex = 0; meshIndex < loadedMeshes.size(); meshIndex++)
+        {
+            stagedIndices[meshIndex] = _asyncUploader.Reserve(
+                uploadBatch,
+                _geometryPool.GetIndexBuffer().buffer,
+                geometryRanges[meshIndex].indexByteOffset,
+                geometryRanges[meshIndex].indexByteSize);
+        }
+
+        // Cooking the mesh cache needs the bytes on the CPU as well, then primitives are decoded into
+        // two blobs laid out like their pool ranges and copied to staging as a whole afterwards
+        auto decodedVertices = stagedVertices;
+        auto decodedIndices = stagedIndices;
+        if (isMeshCacheUsed)
+        {
+            cookedVertexData.resize(vertexDataSize);
+            cookedIndexData.resize(indexDataSize);
+            for (size_t meshIndex = 0; meshIndex < loadedMeshes.size(); meshIndex++)
+            {
+                auto& mesh = loadedMeshes[meshIndex].second;
+                decodedVertices[meshIndex] = cookedVertexData.data() + static_cast<VkDeviceSize>(mesh.vertexOffset - loadedMeshes.front().second.vertexOffset) * vertexStride;
+                decodedIndices[meshIndex] = cookedIndexData.data() + (geometryRanges[meshIndex].indexByteOffset - geometryRanges.front().indexByteOffset);
+            }
+        }
+
+        _jobSystem.ParallelFor(loadedMeshes.size(), 1, [&](size_t meshIndex)
+        {
+            auto& primitive = *primitivesToLoad[meshIndex].primitive;
+            auto& mesh = loadedMeshes[meshIndex].second;
+
+            // Geometry is decoded straight into staging unless it is kept on the CPU, optimized or packed,
+            // those take a detour through CPU memory. Staging memory is never read back
+            auto needsCpuVertices = _keepCpuGeometry || _optimizeGeometry || mesh.vertexFormat == VertexFormat::PackedPositionNormalUv;
+            auto needsCpuIndices = _keepCpuGeometry || _optimizeGeometry;
+
+            std::vector<VertexPositionNormalUv> vertices;
+            if (needsCpuVertices)
+            {
+                vertices.resize(mesh.vertexCount);
+                DecodeVertices(asset, primitive, vertices.data(), mesh.boundsMin, mesh.boundsMax);
+            }
+            else
+            {
+                DecodeVertices(asset, primitive, static_cast<VertexPositionNormalUv*>(decodedVertices[meshIndex]), mesh.boundsMin, mesh.boundsMax);
+            }
+
+            std::vector<uint32_t> indices;
+            if (needsCpuIndices)
+            {
+                indices.resize(mesh.indexCount);
+                DecodeIndices(asset, primitive, indices.data());
+            }
+            else if (mesh.indexType == VkIndexType::VK_INDEX_TYPE_UINT16)
+            {
+                DecodeIndices(asset, primitive, static_cast<uint16_t*>(decodedIndices[meshIndex]));
+            }
+            else
+            {
+                DecodeIndices(asset, primitive, static_cast<uint32_t*>(decodedIndices[meshIndex]));
+            }
+
+            if (_optimizeGeometry)
+            {
+                auto optimizedGeometry = _geometryOptimizationCache.GetOrOptimize(primitivesToLoad[meshIndex].optimizationKey, vertices, indices);
+
+                std::vector<VertexPositionNormalUv> remappedVertices(vertices.size());
+                for (size_t vertexIndex = 0; vertexIndex < vertices.size(); vertexIndex++)
                 {
-                    std::cerr << createBufferResult.error() << "\n";
-                    return false;
+                    remappedVertices[vertexIndex] = vertices[optimizedGeometry->vertexRemap[vertexIndex]];
                 }
 
-                mesh.vertexBuffer = createBufferResult.value();
-
-                SubmitImmediately([=](VkCommandBuffer commandBuffer)
+                vertices = std::move(remappedVertices);
+                indices = optimizedGeometry->indices;
+                transformedVertexCounts[meshIndex] =
                 {
-                    vkCmdCopyBuffer(commandBuffer, createStagingBufferResult.value().buffer, mesh.vertexBuffer.buffer, 1, ToTempPtr(VkBufferCopy
-                    {
-                        .srcOffset = 0,
-                        .dstOffset = 0,
-                        .size = bufferSize
-                    }));
-                });
+                    optimizedGeometry->transformedVertexCountBefore,
+                    optimizedGeometry->transformedVertexCountAfter
+                };
+            }
+
+            if (mesh.vertexFormat == VertexFormat::PackedPositionNormalUv)
+            {
+                mesh.positionOffset = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+                mesh.positionScale = glm::max((mesh.boundsMax - mesh.boundsMin) * 0.5f, glm::vec3(std::numeric_limits<float>::min()));
+                PackVertices(
+                    vertices.data(),
+                    mesh.vertexCount,
+                    mesh.positionOffset,
+                    mesh.positionScale,
+                    static_cast<VertexPackedPositionNormalUv*>(decodedVertices[meshIndex]));
+            }
+            else if (needsCpuVertices)
+            {
+                std::memcpy(decodedVertices[meshIndex], vertices.data(), vertices.size() * sizeof(VertexPositionNormalUv));
+            }
 
-                createBufferResult = CreateBuffer(
-                    std::format("IndexBuffer_{}", node->name),
-                    VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU,
-                    std::span(mesh.indices));
-                if (!createBufferResult.has_value())
+            if (needsCpuIndices)
+            {
+                if (mesh.indexType == VkIndexType::VK_INDEX_TYPE_UINT16)
+                {
+                    NarrowIndices(indices.data(), static_cast<uint16_t*>(decodedIndices[meshIndex]), indices.size());
+                }
+                else
                 {
-                    std::cerr << createBufferResult.error() << "\n";
-                    return false;
+                    std::memcpy(decodedIndices[meshIndex], indices.data(), indices.size() * sizeof(uint32_t));
                 }
+            }
 
-                mesh.indexBuffer = createBufferResult.value();
+            if (_keepCpuGeometry)
+            {
+                mesh.vertices = std::move(vertices);
+                mesh.indices = std::move(indices);
+            }
+        });
 
-                auto meshName = node->name.c_str();
-                meshNames.push_back(meshName);
-                _meshNameToMeshMap.emplace(meshName, mesh);
+        if (isMeshCacheUsed)
+        {
+            std::memcpy(stagedVertices.front(), cookedVertexData.data(), cookedVertexData.size());
+            std::memcpy(stagedIndices.front(), cookedIndexData.data(), cookedIndexData.size());
+        }
+
+        // Only known for optimized geometry, the simulation needs the indices on the CPU
+        for (auto& [transformedVertexCountBefore, transformedVertexCountAfter] : transformedVertexCounts)
+        {
+            modelTransformedVertexCounts.first += transformedVertexCountBefore;
+            modelTransformedVertexCounts.second += transformedVertexCountAfter;
+        }
+
+        streamedModel.uploadBatch = std::move(uploadBatch);
+    }
+
+    uint64_t triangleCount = 0;
+    if (_optimizeGeometry)
+    {
+        for (auto& [meshName, mesh] : loadedMeshes)
+        {
+            triangleCount += mesh.indexCount / 3;
+        }
+    }
+
+    streamedModel.geometryStatistics.triangleCount = triangleCount;
+    streamedModel.geometryStatistics.transformedVertexCountBefore = modelTransformedVertexCounts.first;
+    streamedModel.geometryStatistics.transformedVertexCountAfter = modelTransformedVertexCounts.second;
+
+    // A model which fails to cook still loaded fine, it is cooked again next time
+    if (isMeshCacheUsed)
+    {
+        MeshCacheContents meshCacheContents;
+        meshCacheContents.meshes = loadedMeshes;
+        meshCacheContents.triangleCount = triangleCount;
+        meshCacheContents.transformedVertexCountBefore = modelTransformedVertexCounts.first;
+        meshCacheContents.transformedVertexCountAfter = modelTransformedVertexCounts.second;
+
+        auto writeResult = WriteMeshCache(meshCachePath, path, _vertexFormat, _optimizeGeometry, meshCacheContents, cookedVertexData, cookedIndexData);
+        if (!writeResult.has_value())
+        {
+            std::cerr << writeResult.error() << "\n";
+        }
+    }
+
+    return true;
+}
+
+bool Engine::LoadMeshFromCache(const std::filesystem::path& meshCachePath, MeshCacheContents& meshCacheContents, StreamedModel& streamedModel)
+{
+    ZoneScoped;
+
+    auto& meshes = streamedModel.meshes;
+    meshes = std::move(meshCacheContents.meshes);
+    streamedModel.geometryStatistics.triangleCount = meshCacheContents.triangleCount;
+    streamedModel.geometryStatistics.transformedVertexCountBefore = meshCacheContents.transformedVertexCountBefore;
+    streamedModel.geometryStatistics.transformedVertexCountAfter = meshCacheContents.transformedVertexCountAfter;
+    if (meshes.empty())
+    {
+        return true;
+    }
+
+    auto vertexStride = GetVertexStride(_vertexFormat);
+    std::vector<GeometryRange> geometryRanges(meshes.size());
+    std::unique_lock geometryPoolLock(_geometryPoolMutex);
+    auto poolVertexCount = _geometryPool.GetVertexCount();
+    auto poolIndexByteCount = _geometryPool.GetIndexByteCount();
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); meshIndex++)
+    {
+        auto& mesh = meshes[meshIndex].second;
+        auto geometryRangeResult = _geometryPool.Allocate(mesh.vertexCount, mesh.indexCount, mesh.indexType);
+        if (!geometryRangeResult.has_value())
+        {
+            std::cerr << geometryRangeResult.error() << "\n";
+            _geometryPool.Rewind(poolVertexCount, poolIndexByteCount);
+            return false;
+        }
+
+        mesh.firstIndex = geometryRangeResult.value().firstIndex;
+        mesh.vertexOffset = geometryRangeResult.value().vertexOffset;
+        geometryRanges[meshIndex] = geometryRangeResult.value();
+    }
+    geometryPoolLock.unlock();
+
+    auto uploadBatchResult = _asyncUploader.BeginBatch(meshCacheContents.vertexDataSize + meshCacheContents.indexDataSize);
+    if (!uploadBatchResult.has_value())
+    {
+        std::cerr << uploadBatchResult.error() << "\n";
+        return false;
+    }
+
+    auto& uploadBatch = uploadBatchResult.value();
+
+    // The pool hands out consecutive ranges in the order the model was cooked in, so each blob is one region
+    auto* stagedVertices = _asyncUploader.Reserve(
+        uploadBatch,
+        _geometryPool.GetVertexBuffer().buffer,
+        static_cast<VkDeviceSize>(geometryRanges.front().vertexOffset) * vertexStride,
+        meshCacheContents.vertexDataSize);
+    auto* stagedIndices = _asyncUploader.Reserve(
+        uploadBatch,
+        _geometryPool.GetIndexBuffer().buffer,
+        geometryRanges.front().indexByteOffset,
+        meshCacheContents.indexDataSize);
+
+    auto readResult = ReadMeshCacheData(meshCachePath, meshCacheContents, stagedVertices, stagedIndices);
+    if (!readResult.has_value())
+    {
+        std::cerr << readResult.error() << "\n";
+        return false;
+    }
+
+    streamedModel.uploadBatch = std::move(uploadBatch);
+
+    return true;
+}
+
+void Engine::RequestModel(
+    const std::string& modelName,
+    const std::string& filePath,
+    std::function<void(const std::string& modelName)>&& onLoaded)
+{
+    _jobSystem.ScheduleBackground(_streamingCounter, [this, modelName, filePath, onLoaded = std::move(onLoaded)]() mutable
+    {
+        StreamedModel streamedModel;
+        streamedModel.modelName = modelName;
+        streamedModel.onLoaded = std::move(onLoaded);
+        if (!LoadMeshFromFile(filePath, streamedModel))
+        {
+            std::cerr << std::format("Engine: Failed to load {} from {}\n", modelName, filePath);
+            return;
+        }
+
+        std::lock_guard lock(_streamedModelsMutex);
+        _streamedModels.push_back(std::move(streamedModel));
+    });
+}
+
+bool Engine::CommitStreamedModels()
+{
+    ZoneScoped;
+
+    std::vector<StreamedModel> streamedModels;
+    {
+        std::lock_guard lock(_streamedModelsMutex);
+        streamedModels.swap(_streamedModels);
+    }
+
+    for (auto& streamedModel : streamedModels)
+    {
+        uint64_t uploadTicket = 0;
+        if (streamedModel.uploadBatch.has_value())
+        {
+            auto uploadResult = _asyncUploader.SubmitBatch(streamedModel.uploadBatch.value());
+            if (!uploadResult.has_value())
+            {
+                std::cerr << uploadResult.error() << "\n";
+                return false;
             }
 
+            uploadTicket = uploadResult.value();
+        }
+
+        _geometryStatistics.triangleCount += streamedModel.geometryStatistics.triangleCount;
+        _geometryStatistics.transformedVertexCountBefore += streamedModel.geometryStatistics.transformedVertexCountBefore;
+        _geometryStatistics.transformedVertexCountAfter += streamedModel.geometryStatistics.transformedVertexCountAfter;
+
+        RegisterModel(streamedModel.modelName, streamedModel.meshes, uploadTicket);
+
+        if (streamedModel.onLoaded)
+        {
+            streamedModel.onLoaded(streamedModel.modelName);
         }
     }
 
-    _modelNameToMeshNameMap.emplace(modelName, meshNames);
+    // onLoaded callbacks add renderables in whatever order suits them
+    if (!streamedModels.empty())
+    {
+        SortRenderables();
+    }
 
     return true;
 }
 
+void Engine::RegisterModel(const std::string& modelName, std::vector<std::pair<std::string, Mesh>>& meshes, uint64_t uploadTicket)
+{
+    std::vector<std::string> meshNames;
+    meshNames.reserve(meshes.size());
+    for (auto& [meshName, mesh] : meshes)
+    {
+        mesh.uploadTicket = uploadTicket;
+        meshNames.push_back(meshName);
+        _meshNameToMeshMap.emplace(meshName, std::move(mesh));
+    }
+
+    _modelNameToMeshNameMap.emplace(modelName, meshNames);
+}
+
+void Engine::SortRenderables()
+{
+    ZoneScoped;
+
+    std::stable_sort(_renderables.begin(), _renderables.end(), [](const Renderable& left, const Renderable& right)
+    {
+        if (left.pipeline != right.pipeline)
+        {
+            return left.pipeline < right.pipeline;
+        }
+
+        if (left.mesh->indexType != right.mesh->indexType)
+        {
+            return left.mesh->indexType < right.mesh->indexType;
+        }
+
+        // Unrelated pointers are only totally ordered through std::less
+        return std::less<const Mesh*>{}(left.mesh, right.mesh);
+    });
+}
+
 bool Engine::Draw()
 {
-    FrameData frameData = GetCurrentFrameData();
+    ZoneScoped;
+
+    auto frameStartTime = std::chrono::steady_clock::now();
+    _frameStatistics.isRendered = false;
+
+    if (!CommitStreamedModels())
+    {
+        return false;
+    }
 
-    VkResult result = vkWaitForFences(_device, 1, &frameData.renderFence, true, 1000000000);
+    _pipelineCompiler.Commit();
+
+    FrameData& frameData = GetCurrentFrameData();
+
+    VkResult result = VK_SUCCESS;
+    auto fenceWaitStartTime = std::chrono::steady_clock::now();
+    {
+        ZoneScopedN("WaitForRenderFence");
+        result = vkWaitForFences(_device, 1, &frameData.renderFence, true, 1000000000);
+    }
+    _frameStatistics.fenceWaitTimeMs = MillisecondsSince(fenceWaitStartTime);
     if (result != VK_SUCCESS)
     {
         std::cerr << "Vulkan: Unable to wait for render fence\n" << result << "\n";
         return false;
     }
 
-    if (vkResetFences(_device, 1, &frameData.renderFence) != VK_SUCCESS)
+    // In headless mode every frame in flight owns its own offscreen framebuffer
+    uint32_t swapchainImageIndex = _frameIndex % FRAMES_IN_FLIGHT;
+    if (!_headless)
     {
-        std::cerr << "Vulkan: Unable to reset render fence\n";
-        return false;
+        DestroyRetiredSwapchains(false);
+
+        if (_isSwapchainOutOfDate && !RecreateSwapchain())
+        {
+            return false;
+        }
+
+        // Minimized, nothing to present to
+        if (_isSwapchainOutOfDate)
+        {
+            return true;
+        }
+
+        result = vkAcquireNextImageKHR(
+            _device,
+            _swapchain,
+            1000000000,
+            frameData.presentSemaphore,
+            nullptr,
+            &swapchainImageIndex);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        {
+            // Nothing was acquired and the fence is still signaled, the next Draw recreates and tries again
+            _isSwapchainOutOfDate = true;
+            return true;
+        }
+
+        if (result == VK_SUBOPTIMAL_KHR)
+        {
+            // The image is acquired and its semaphore will signal, so it is still rendered and presented
+            _isSwapchainOutOfDate = true;
+        }
+        else if (result != VK_SUCCESS)
+        {
+            std::cerr << "Vulkan: Unable to acquire next image\n";
+            return false;
+        }
     }
 
-    uint32_t swapchainImageIndex;
-    if (vkAcquireNextImageKHR(
-        _device,
-        _swapchain,
-        1000000000,
-        frameData.presentSemaphore,
-        nullptr,
-        &swapchainImageIndex) != VK_SUCCESS)
+    // Only reset once this frame is certain to submit, otherwise the next wait on it would never return
+    if (vkResetFences(_device, 1, &frameData.renderFence) != VK_SUCCESS)
     {
-        std::cerr << "Vulkan: Unable to acquire next image\n";
+        std::cerr << "Vulkan: Unable to reset render fence\n";
         return false;
     }
 
@@ -567,38 +1352,67 @@ bool Engine::Draw()
     commandBufferBeginInfo.pInheritanceInfo = nullptr;
     commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
+    auto recordStartTime = std::chrono::steady_clock::now();
+
     if (vkBeginCommandBuffer(frameData.commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
     {
         std::cerr << "Vulkan: Failed to begin command buffer\n";
         return false;
     }
 
-    VkClearValue clearValue;
-    float flash = abs(sin(_frameIndex / 120.f));
-    clearValue.color = { { 0.0f, 0.0f, flash, 1.0f } };
+    // Timings resolved here are the ones recorded the last time this frame slot was used
+    _gpuProfiler.BeginFrame(frameData.commandBuffer, frameData.timestampQueries);
+    auto gpuTimings = _gpuProfiler.GetTimings();
+    if (!gpuTimings.empty())
+    {
+        _frameStatistics.gpuTimeMs = gpuTimings.front().milliseconds;
+    }
+
+    // Meshes whose copy finished by now take part in this frame
+    _residentUploadTicket = _asyncUploader.AcquireCompletedUploads(frameData.commandBuffer);
+
+    {
+        GPU_PROFILE_SCOPE(_gpuProfiler, frameData.commandBuffer, "Frame");
+
+        VkClearValue clearValue;
+        float flash = abs(sin(_frameIndex / 120.f));
+        clearValue.color = { { 0.0f, 0.0f, flash, 1.0f } };
+
+        VkClearValue clearDepthValue;
+        clearDepthValue.depthStencil.depth = 1;
+
+        VkRenderPassBeginInfo renderPassBeginInfo = {};
+        renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBeginInfo.pNext = nullptr;
 
-    VkClearValue clearDepthValue;
-    clearDepthValue.depthStencil.depth = 1;
+        renderPassBeginInfo.renderPass = _renderPass;
+        renderPassBeginInfo.renderArea.offset.x = 0;
+        renderPassBeginInfo.renderArea.offset.y = 0;
+        renderPassBeginInfo.renderArea.extent = _windowExtent;
+        renderPassBeginInfo.framebuffer = _framebuffers[swapchainImageIndex];
 
-    VkRenderPassBeginInfo renderPassBeginInfo = {};
-    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassBeginInfo.pNext = nullptr;
+        VkClearValue clearValues[2] = { clearValue, clearDepthValue };
+        renderPassBeginInfo.clearValueCount = 2;
+        renderPassBeginInfo.pClearValues = &clearValues[0];
 
-    renderPassBeginInfo.renderPass = _renderPass;
-    renderPassBeginInfo.renderArea.offset.x = 0;
-    renderPassBeginInfo.renderArea.offset.y = 0;
-    renderPassBeginInfo.renderArea.extent = _windowExtent;
-    renderPassBeginInfo.framebuffer = _framebuffers[swapchainImageIndex];
+        {
+            GPU_PROFILE_SCOPE(_gpuProfiler, frameData.commandBuffer, "OpaquePass");
+
+            vkCmdBeginRenderPass(frameData.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);    
 
-    VkClearValue clearValues[2] = { clearValue, clearDepthValue };
-    renderPassBeginInfo.clearValueCount = 2;
-    renderPassBeginInfo.pClearValues = &clearValues[0];
+            auto isDrawn = DrawRenderables(frameData.commandBuffer, _renderables.data(), _renderables.size());
 
-    vkCmdBeginRenderPass(frameData.commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);    
+            vkCmdEndRenderPass(frameData.commandBuffer);
 
-    DrawRenderables(frameData.commandBuffer, _renderables.data(), _renderables.size());
+            // Submitting would show a frame without its objects
+            if (!isDrawn)
+            {
+                return false;
+            }
+        }
+    }
 
-    vkCmdEndRenderPass(frameData.commandBuffer);
+    _gpuProfiler.EndFrame(frameData.commandBuffer);
 
     if (vkEndCommandBuffer(frameData.commandBuffer) != VK_SUCCESS)
     {
@@ -606,16 +1420,29 @@ bool Engine::Draw()
         return false;
     }
 
+    _frameStatistics.recordTimeMs = MillisecondsSince(recordStartTime);
+    auto submitStartTime = std::chrono::steady_clock::now();
+
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.pNext = nullptr;
 
-    VkPipelineStageFlags waitStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-    submitInfo.pWaitDstStageMask = &waitStageFlags;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &frameData.presentSemaphore;
-    submitInfo.signalSemaphoreCount = 1;
+    // Nothing to acquire or present in headless mode, the render fence is all we need.
+    // The upload timeline is always waited on, the frame may draw from the latest acquired uploads
+    VkSemaphore waitSemaphores[] = { _asyncUploader.GetTimelineSemaphore(), frameData.presentSemaphore };
+    VkPipelineStageFlags waitStageFlags[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+    uint64_t waitSemaphoreValues[] = { _residentUploadTicket, 0 };
+
+    VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo = {};
+    timelineSemaphoreSubmitInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineSemaphoreSubmitInfo.pNext = nullptr;
+    timelineSemaphoreSubmitInfo.waitSemaphoreValueCount = _headless ? 1 : 2;
+    timelineSemaphoreSubmitInfo.pWaitSemaphoreValues = waitSemaphoreValues;
+
+    submitInfo.pNext = &timelineSemaphoreSubmitInfo;
+    submitInfo.pWaitDstStageMask = waitStageFlags;
+    submitInfo.waitSemaphoreCount = _headless ? 1 : 2;
+    submitInfo.pWaitSemaphores = waitSemaphores;
+    submitInfo.signalSemaphoreCount = _headless ? 0 : 1;
     submitInfo.pSignalSemaphores = &frameData.renderSemaphore;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &frameData.commandBuffer;
@@ -626,6 +1453,17 @@ bool Engine::Draw()
         return false;
     }
 
+    if (_headless)
+    {
+        _frameStatistics.submitTimeMs = MillisecondsSince(submitStartTime);
+        _frameStatistics.cpuFrameTimeMs = MillisecondsSince(frameStartTime);
+        _frameStatistics.isGpuBound = _frameStatistics.gpuTimeMs > _frameStatistics.cpuFrameTimeMs - _frameStatistics.fenceWaitTimeMs;
+        _frameStatistics.isRendered = true;
+        FrameMark;
+        _frameIndex++;
+        return true;
+    }
+
     // present
 
     VkPresentInfoKHR presentInfo = {};
@@ -637,12 +1475,22 @@ bool Engine::Draw()
     presentInfo.waitSemaphoreCount = 1;
     presentInfo.pImageIndices = &swapchainImageIndex;
 
-    if (vkQueuePresentKHR(_graphicsQueue, &presentInfo) != VK_SUCCESS)
+    result = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+    {
+        _isSwapchainOutOfDate = true;
+    }
+    else if (result != VK_SUCCESS)
     {
         std::cerr << "Vulkan: Failed to present\n";
         return false;
     }
 
+    _frameStatistics.submitTimeMs = MillisecondsSince(submitStartTime);
+    _frameStatistics.cpuFrameTimeMs = MillisecondsSince(frameStartTime);
+    _frameStatistics.isGpuBound = _frameStatistics.gpuTimeMs > _frameStatistics.cpuFrameTimeMs - _frameStatistics.fenceWaitTimeMs;
+    _frameStatistics.isRendered = true;
+    FrameMark;
     _frameIndex++;
 
     return true;
@@ -650,7 +1498,7 @@ bool Engine::Draw()
 
 bool Engine::InitializeVulkan()
 {
-    if (glfwVulkanSupported() == GLFW_FALSE)
+    if (!_headless && glfwVulkanSupported() == GLFW_FALSE)
     {
         std::cerr << "Vulkan: Not supported\n";
         return false;
@@ -669,7 +1517,8 @@ bool Engine::InitializeVulkan()
     vkb::InstanceBuilder instanceBuilder;
     auto instanceResult = instanceBuilder
         .set_app_name("Fuk")
-        .require_api_version(1, 2, 0)        
+        .require_api_version(1, 2, 0)
+        .set_headless(_headless)
 #ifdef _DEBUG        
         .request_validation_layers()
         .enable_validation_layers()
@@ -696,17 +1545,30 @@ bool Engine::InitializeVulkan()
     // Initialize Device
     //
 
-    _surface = CreateSurface(_instance, _window);
-    if (_surface == nullptr)
+    vkb::PhysicalDeviceSelector physicalDeviceSelector{ vkbInstance };
+    if (!_headless)
     {
-        return false;
+        _surface = CreateSurface(_instance, _window);
+        if (_surface == nullptr)
+        {
+            return false;
+        }
+
+        physicalDeviceSelector.set_surface(_surface);
     }
 
-    vkb::PhysicalDeviceSelector physicalDeviceSelector{ vkbInstance };
     auto physicalDeviceSelectionResult = physicalDeviceSelector
-        .set_surface(_surface)
         .set_minimum_version(1, 2)
-        .require_dedicated_transfer_queue()
+        .set_required_features(VkPhysicalDeviceFeatures
+        {
+            .multiDrawIndirect = VK_TRUE,
+            .drawIndirectFirstInstance = VK_TRUE,
+        })
+        .set_required_features_12(VkPhysicalDeviceVulkan12Features
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+            .timelineSemaphore = VK_TRUE,
+        })
         .add_required_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)
         .add_required_extension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
         .select();
@@ -716,16 +1578,36 @@ bool Engine::InitializeVulkan()
         return false;
     }
 
-    vkb::DeviceBuilder deviceBuilder{ physicalDeviceSelectionResult.value() };
+    // Only pipelines asking for dynamic cull mode or depth test need it, devices without it are not turned away
+    auto vkbPhysicalDevice = physicalDeviceSelectionResult.value();
+    _isExtendedDynamicStateEnabled = vkbPhysicalDevice.enable_extension_if_present(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+
+    vkb::DeviceBuilder deviceBuilder{ vkbPhysicalDevice };
 
     VkPhysicalDeviceShaderDrawParametersFeatures shaderDrawParametersFeatures = {};
     shaderDrawParametersFeatures.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES;
     shaderDrawParametersFeatures.pNext = nullptr;
     shaderDrawParametersFeatures.shaderDrawParameters = VK_TRUE;
 
-    auto deviceBuilderResult = deviceBuilder
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT graphicsPipelineLibraryFeatures = {};
+    graphicsPipelineLibraryFeatures.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+    graphicsPipelineLibraryFeatures.pNext = nullptr;
+    graphicsPipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures = {};
+    extendedDynamicStateFeatures.sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+    extendedDynamicStateFeatures.pNext = nullptr;
+    extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
+
+    deviceBuilder
         .add_pNext(&shaderDrawParametersFeatures)
-        .build();
+        .add_pNext(&graphicsPipelineLibraryFeatures);
+    if (_isExtendedDynamicStateEnabled)
+    {
+        deviceBuilder.add_pNext(&extendedDynamicStateFeatures);
+    }
+
+    auto deviceBuilderResult = deviceBuilder.build();
     if (!deviceBuilderResult)
     {
         std::cerr << "Vulkan: Failed to create vulkan device.\nDetails: " << deviceBuilderResult.error().message() << "\n";
@@ -742,9 +1624,31 @@ bool Engine::InitializeVulkan()
 
     _graphicsQueue = vkbDevice.get_queue(vkb::QueueType::graphics).value();
     _graphicsQueueFamily = vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
+    _graphicsQueueTimestampValidBits = vkbDevice.queue_families[_graphicsQueueFamily].timestampValidBits;
 
     SetDebugName(_device, _graphicsQueue, "Graphics Queue");    
 
+    // Uploads prefer a dedicated transfer queue, then any other transfer capable one, then the graphics queue
+    auto transferQueueResult = vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+    auto transferQueueIndexResult = vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer);
+    if (!transferQueueResult || !transferQueueIndexResult)
+    {
+        transferQueueResult = vkbDevice.get_queue(vkb::QueueType::transfer);
+        transferQueueIndexResult = vkbDevice.get_queue_index(vkb::QueueType::transfer);
+    }
+
+    if (transferQueueResult && transferQueueIndexResult)
+    {
+        _transferQueue = transferQueueResult.value();
+        _transferQueueFamily = transferQueueIndexResult.value();
+        SetDebugName(_device, _transferQueue, "Transfer Queue");
+    }
+    else
+    {
+        _transferQueue = _graphicsQueue;
+        _transferQueueFamily = _graphicsQueueFamily;
+    }
+
     if (vmaCreateAllocator(
         ToTempPtr(VmaAllocatorCreateInfo
         {
@@ -767,12 +1671,29 @@ bool Engine::InitializeVulkan()
 }
 
 bool Engine::InitializeSwapchain()
+{
+    if (!CreateSwapchain(VK_NULL_HANDLE))
+    {
+        return false;
+    }
+
+    // Whichever swapchain is current by then, retired ones are destroyed by DestroyRetiredSwapchains
+    _deletionQueue.Push([=, this]()
+    {
+        vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+    });
+
+    return true;
+}
+
+bool Engine::CreateSwapchain(VkSwapchainKHR oldSwapchain)
 {
     vkb::SwapchainBuilder swapchainBuilder{ _physicalDevice, _device, _surface };
     auto swapchainBuilderResult = swapchainBuilder
         .use_default_format_selection()
         .set_desired_present_mode(_vsync ? VkPresentModeKHR::VK_PRESENT_MODE_FIFO_KHR : VkPresentModeKHR::VK_PRESENT_MODE_IMMEDIATE_KHR)
         .set_desired_extent(_windowExtent.width, _windowExtent.height)
+        .set_old_swapchain(oldSwapchain)
         .build();
     if (!swapchainBuilderResult)
     {
@@ -786,14 +1707,155 @@ bool Engine::InitializeSwapchain()
     _swapchainImages = vkbSwapchain.get_images().value();
     _swapchainImageViews = vkbSwapchain.get_image_views().value();
     _swapchainImageFormat = vkbSwapchain.image_format;
+    // The surface has the final say, it may differ from what was asked for
+    _windowExtent = vkbSwapchain.extent;
 
     SetDebugName(_device, _swapchain, "SwapChain");
 
-    _deletionQueue.Push([=, this]()
+    return true;
+}
+
+bool Engine::InitializeDepthImage()
+{
+    auto depthImageResult = CreateImage(
+        "DepthImage",
+        _depthFormat,
+        VkImageUsageFlagBits::VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        VkImageAspectFlagBits::VK_IMAGE_ASPECT_DEPTH_BIT,
+        VkExtent3D
+        {
+            .width = _windowExtent.width,
+            .height = _windowExtent.height,
+            .depth = 1
+        },
+        false);
+    if (!depthImageResult.has_value())
     {
-        vkDestroySwapchainKHR(_device, _swapchain, nullptr);
+        std::cerr << depthImageResult.error();
+        return false;
+    }
+
+    _depthImage = depthImageResult.value();
+
+    return true;
+}
+
+bool Engine::RecreateSwapchain()
+{
+    ZoneScoped;
+
+    int32_t framebufferWidth = 0;
+    int32_t framebufferHeight = 0;
+    glfwGetFramebufferSize(_window, &framebufferWidth, &framebufferHeight);
+    if (framebufferWidth == 0 || framebufferHeight == 0)
+    {
+        return true;
+    }
+
+    // Frames already submitted keep rendering to and presenting the old targets, they go once those retired.
+    // Retired before creating the new ones, so they are destroyed even when recreation fails
+    _retiredSwapchains.push_back(RetiredSwapchain
+    {
+        .swapchain = _swapchain,
+        .imageViews = std::move(_swapchainImageViews),
+        .framebuffers = std::move(_framebuffers),
+        .depthImage = _depthImage,
+        .lastFrameIndex = _frameIndex - 1,
     });
 
+    auto oldSwapchain = _swapchain;
+    _swapchain = VK_NULL_HANDLE;
+    _swapchainImageViews.clear();
+    _framebuffers.clear();
+    _depthImage = {};
+
+    _windowExtent.width = static_cast<uint32_t>(framebufferWidth);
+    _windowExtent.height = static_cast<uint32_t>(framebufferHeight);
+
+    if (!CreateSwapchain(oldSwapchain))
+    {
+        return false;
+    }
+
+    if (!InitializeDepthImage())
+    {
+        return false;
+    }
+
+    if (!InitializeFramebuffers())
+    {
+        std::cerr << "Vulkan: Failed to recreate framebuffers\n";
+        return false;
+    }
+
+    _isSwapchainOutOfDate = false;
+
+    return true;
+}
+
+void Engine::DestroyRetiredSwapchains(bool isDeviceIdle)
+{
+    // Called once the current frame's fence signaled, so every frame up to FRAMES_IN_FLIGHT back has finished
+    auto lastFinishedFrameIndex = _frameIndex - static_cast<int32_t>(FRAMES_IN_FLIGHT);
+    std::erase_if(_retiredSwapchains, [&](RetiredSwapchain& retiredSwapchain)
+    {
+        if (!isDeviceIdle && retiredSwapchain.lastFrameIndex > lastFinishedFrameIndex)
+        {
+            return false;
+        }
+
+        for (auto framebuffer : retiredSwapchain.framebuffers)
+        {
+            vkDestroyFramebuffer(_device, framebuffer, nullptr);
+        }
+
+        for (auto imageView : retiredSwapchain.imageViews)
+        {
+            vkDestroyImageView(_device, imageView, nullptr);
+        }
+
+        DestroyImage(retiredSwapchain.depthImage);
+        vkDestroySwapchainKHR(_device, retiredSwapchain.swapchain, nullptr);
+        return true;
+    });
+}
+
+bool Engine::InitializeOffscreenTargets()
+{
+    for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++)
+    {
+        auto offscreenImageResult = CreateImage(
+            std::format("OffscreenImage_{}", i),
+            _offscreenImageFormat,
+            VkImageUsageFlagBits::VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VkImageUsageFlagBits::VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT,
+            VkExtent3D
+            {
+                .width = _windowExtent.width,
+                .height = _windowExtent.height,
+                .depth = 1
+            });
+        if (!offscreenImageResult.has_value())
+        {
+            std::cerr << offscreenImageResult.error() << "\n";
+            return false;
+        }
+
+        _frameDates[i].offscreenImage = offscreenImageResult.value();
+    }
+
+    auto readbackBufferResult = CreateBuffer<uint8_t>(
+        "ReadbackBuffer",
+        static_cast<VkDeviceSize>(_windowExtent.width) * _windowExtent.height * 4,
+        MemoryPlacement::HostReadback);
+    if (!readbackBufferResult.has_value())
+    {
+        std::cerr << readbackBufferResult.error() << "\n";
+        return false;
+    }
+
+    _readbackBuffer = readbackBufferResult.value();
+
     return true;
 }
 
@@ -841,6 +1903,31 @@ bool Engine::InitializeCommandBuffers()
         {
             vkDestroyCommandPool(_device, _frameDates[i].commandPool, nullptr);
         });
+
+        // GPU timings are optional, not every graphics queue supports timestamps
+        if (_graphicsQueueTimestampValidBits > 0)
+        {
+            if (vkCreateQueryPool(
+                _device,
+                ToTempPtr(VkQueryPoolCreateInfo
+                {
+                    .sType = VkStructureType::VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+                    .pNext = nullptr,
+                    .queryType = VkQueryType::VK_QUERY_TYPE_TIMESTAMP,
+                    .queryCount = MAX_GPU_PROFILER_QUERIES,
+                }),
+                nullptr,
+                &_frameDates[i].timestampQueries.queryPool) != VK_SUCCESS)
+            {
+                std::cerr << "Vulkan: Failed to create timestamp query pool\n";
+                return false;
+            }
+
+            _deletionQueue.Push([=, this]()
+            {
+                vkDestroyQueryPool(_device, _frameDates[i].timestampQueries.queryPool, nullptr);
+            });
+        }
     }
 
     if (vkCreateCommandPool(
@@ -886,14 +1973,14 @@ bool Engine::InitializeRenderPass()
     _depthFormat = VkFormat::VK_FORMAT_D32_SFLOAT;
 
     VkAttachmentDescription colorAttachmentDescription = {};
-    colorAttachmentDescription.format = _swapchainImageFormat;
+    colorAttachmentDescription.format = _headless ? _offscreenImageFormat : _swapchainImageFormat;
     colorAttachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
     colorAttachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
     colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAttachmentDescription.finalLayout = _headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentReference = {};
     colorAttachmentReference.attachment = 0;
@@ -987,13 +2074,22 @@ bool Engine::InitializeFramebuffers()
     framebufferCreateInfo.height = _windowExtent.height;
     framebufferCreateInfo.layers = 1;
 
-    auto swapchainImageCount = _swapchainImages.size();
-    _framebuffers = std::vector<VkFramebuffer>(swapchainImageCount);
+    std::vector<VkImageView> colorImageViews = _swapchainImageViews;
+    if (_headless)
+    {
+        for (auto& frameData : _frameDates)
+        {
+            colorImageViews.push_back(frameData.offscreenImage.imageView);
+        }
+    }
 
-    for (size_t i = 0; i < swapchainImageCount; i++)
+    auto colorImageCount = colorImageViews.size();
+    _framebuffers = std::vector<VkFramebuffer>(colorImageCount);
+
+    for (size_t i = 0; i < colorImageCount; i++)
     {
         VkImageView attachments[2];
-        attachments[0] = _swapchainImageViews[i];
+        attachments[0] = colorImageViews[i];
         attachments[1] = _depthImage.imageView;
 
         framebufferCreateInfo.attachmentCount = 2;
@@ -1014,7 +2110,8 @@ bool Engine::InitializeDescriptors()
     {
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 16 },
         { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 16 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16 }
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 16 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 16 }
     };
 
     if (vkCreateDescriptorPool(
@@ -1038,7 +2135,7 @@ bool Engine::InitializeDescriptors()
     VkDescriptorSetLayoutBinding gpuCameraDataBufferBinding = {};
     gpuCameraDataBufferBinding.binding = 0;
     gpuCameraDataBufferBinding.descriptorCount = 1;
-    gpuCameraDataBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    gpuCameraDataBufferBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     gpuCameraDataBufferBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
     VkDescriptorSetLayoutBinding gpuSceneDataBufferBinding = {};
@@ -1075,7 +2172,7 @@ bool Engine::InitializeDescriptors()
     VkDescriptorSetLayoutBinding objectDescriptorSetLayoutBinding = {};
     objectDescriptorSetLayoutBinding.binding = 0;
     objectDescriptorSetLayoutBinding.descriptorCount = 1;
-    objectDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    objectDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
     objectDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
     VkDescriptorSetLayoutCreateInfo objectDescriptorSetLayoutCreateInfo = {};
@@ -1104,45 +2201,8 @@ bool Engine::InitializeDescriptors()
         vkDestroyDescriptorPool(_device, _descriptorPool, nullptr);
     });
 
-    const size_t gpuSceneDataBufferSize = FRAMES_IN_FLIGHT * PadUniformBufferSize(sizeof(GpuSceneData));
-    auto gpuSceneDataBufferResult = CreateBuffer<GpuSceneData>(
-        "GpuSceneData",
-        gpuSceneDataBufferSize,
-        VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU);
-    if (!gpuSceneDataBufferResult.has_value())
-    {
-        std::cerr << gpuSceneDataBufferResult.error() << "\n";
-        return false;
-    }
-
-    _gpuSceneDataBuffer = gpuSceneDataBufferResult.value();
-
     for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++)
     {
-        std::string label = std::format("GpuCameraData_{}", i);
-        auto createBufferResult = CreateBuffer<GpuCameraData>(
-            label,
-            VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU);
-        if (!createBufferResult.has_value())
-        {
-            return false;
-        }
-
-        _frameDates[i].cameraBuffer = createBufferResult.value();
-
-        size_t dataSize = 100 * sizeof(GpuObjectData);
-        label = std::format("GpuObjectData_{}", i);
-        createBufferResult = CreateBuffer<GpuObjectData>(
-            label,
-            dataSize,
-            VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_TO_GPU);
-        if (!createBufferResult.has_value())
-        {
-            return false;
-        }
-
-        _frameDates[i].objectBuffer = createBufferResult.value();
-
         if (vkAllocateDescriptorSets(
             _device,
             ToTempPtr(VkDescriptorSetAllocateInfo
@@ -1179,63 +2239,137 @@ bool Engine::InitializeDescriptors()
 
         SetDebugName(_device, _frameDates[i].objectDescriptorSet, "ObjectDescriptorSet");
 
-        VkDescriptorBufferInfo gpuCameraDataDescriptorBufferInfo = {};
-        gpuCameraDataDescriptorBufferInfo.buffer = _frameDates[i].cameraBuffer.buffer;
-        gpuCameraDataDescriptorBufferInfo.offset = 0;
-        gpuCameraDataDescriptorBufferInfo.range = sizeof(GpuCameraData);
-
-        VkWriteDescriptorSet gpuCameraDataWriteDescriptorSet = {};
-        gpuCameraDataWriteDescriptorSet.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        gpuCameraDataWriteDescriptorSet.pNext = nullptr;
-        gpuCameraDataWriteDescriptorSet.dstBinding = 0;
-        gpuCameraDataWriteDescriptorSet.dstSet = _frameDates[i].globalDescriptorSet;
-        gpuCameraDataWriteDescriptorSet.descriptorCount = 1;
-        gpuCameraDataWriteDescriptorSet.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        gpuCameraDataWriteDescriptorSet.pBufferInfo = &gpuCameraDataDescriptorBufferInfo;
-
-        VkDescriptorBufferInfo gpuSceneDataDescriptorBufferInfo = {};
-        gpuSceneDataDescriptorBufferInfo.buffer = _gpuSceneDataBuffer.buffer;
-        gpuSceneDataDescriptorBufferInfo.offset = 0;
-        gpuSceneDataDescriptorBufferInfo.range = sizeof(GpuSceneData);
-
-        VkWriteDescriptorSet gpuSceneDataWriteDescriptorSet = {};
-        gpuSceneDataWriteDescriptorSet.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        gpuSceneDataWriteDescriptorSet.pNext = nullptr;
-        gpuSceneDataWriteDescriptorSet.dstBinding = 1;
-        gpuSceneDataWriteDescriptorSet.dstSet = _frameDates[i].globalDescriptorSet;
-        gpuSceneDataWriteDescriptorSet.descriptorCount = 1;
-        gpuSceneDataWriteDescriptorSet.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-        gpuSceneDataWriteDescriptorSet.pBufferInfo = &gpuSceneDataDescriptorBufferInfo;
-
-        VkDescriptorBufferInfo gpuObjectDataDescriptorBufferInfo = {};
-        gpuObjectDataDescriptorBufferInfo.buffer = _frameDates[i].objectBuffer.buffer;
-        gpuObjectDataDescriptorBufferInfo.offset = 0;
-        gpuObjectDataDescriptorBufferInfo.range = 100 * sizeof(GpuObjectData);
-
-        VkWriteDescriptorSet gpuObjectDataWriteDescriptorSet = {};
-        gpuObjectDataWriteDescriptorSet.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        gpuObjectDataWriteDescriptorSet.pNext = nullptr;
-        gpuObjectDataWriteDescriptorSet.dstBinding = 0;
-        gpuObjectDataWriteDescriptorSet.dstSet = _frameDates[i].objectDescriptorSet;
-        gpuObjectDataWriteDescriptorSet.descriptorCount = 1;
-        gpuObjectDataWriteDescriptorSet.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        gpuObjectDataWriteDescriptorSet.pBufferInfo = &gpuObjectDataDescriptorBufferInfo;
-
-        VkWriteDescriptorSet writeDescriptorSets[] =
-        {
-            gpuCameraDataWriteDescriptorSet,
-            gpuSceneDataWriteDescriptorSet,
-            gpuObjectDataWriteDescriptorSet
-        };
+        // The upload ring is replaced when it grows, so it is destroyed
+        // through whatever FrameData points at when the deletion queue is flushed
+        _deletionQueue.Push([=, this]()
+        {
+            auto& uploadBuffer = _frameDates[i].uploadRing.GetBuffer();
+            vmaDestroyBuffer(_allocator, uploadBuffer.buffer, uploadBuffer.allocation);
+        });
+
+        if (!EnsureObjectCapacity(_frameDates[i], INITIAL_OBJECT_CAPACITY))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Engine::EnsureObjectCapacity(FrameData& frameData, size_t objectCount)
+{
+    if (objectCount <= frameData.objectCapacity)
+    {
+        return true;
+    }
+
+    // Only called once the frame's render fence has signaled, nothing on the GPU uses the old buffer anymore
+    auto& oldUploadBuffer = frameData.uploadRing.GetBuffer();
+    vmaDestroyBuffer(_allocator, oldUploadBuffer.buffer, oldUploadBuffer.allocation);
+    frameData.uploadRing.Initialize({});
+    frameData.objectCapacity = 0;
+
+    auto objectCapacity = std::bit_ceil(std::max<size_t>(objectCount, INITIAL_OBJECT_CAPACITY));
+    auto objectDataSize = objectCapacity * sizeof(GpuObjectData);
+    if (objectDataSize > _physicalDeviceProperties.limits.maxStorageBufferRange)
+    {
+        std::cerr << std::format("Engine: {} objects exceed the maximum storage buffer range\n", objectCount);
+        return false;
+    }
 
-        vkUpdateDescriptorSets(
-            _device,
-            3,
-            writeDescriptorSets,
-            0,
-            nullptr);
+    // at worst every object is its own draw, alignment padding is accounted for per allocation
+    VkDeviceSize uploadBufferSize =
+        PadUniformBufferSize(sizeof(GpuCameraData)) +
+        PadUniformBufferSize(sizeof(GpuSceneData)) +
+        PadStorageBufferSize(objectDataSize) +
+        objectCapacity * sizeof(VkDrawIndexedIndirectCommand) +
+        _physicalDeviceProperties.limits.minUniformBufferOffsetAlignment +
+        _physicalDeviceProperties.limits.minStorageBufferOffsetAlignment +
+        sizeof(uint32_t);
+
+    AllocatedBuffer uploadBuffer;
+    uploadBuffer.bufferSize = uploadBufferSize;
+    VmaAllocationInfo allocationInfo = {};
+    if (vmaCreateBuffer(
+        _allocator,
+        ToTempPtr(VkBufferCreateInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .size = uploadBufferSize,
+            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+        }),
+        ToTempPtr(ToAllocationCreateInfo(_frameDataPlacement)),
+        &uploadBuffer.buffer,
+        &uploadBuffer.allocation,
+        &allocationInfo) != VK_SUCCESS)
+    {
+        std::cerr << "Vulkan: Failed to create upload buffer\n";
+        return false;
     }
 
+    uploadBuffer.mappedData = allocationInfo.pMappedData;
+    SetDebugName(_device, uploadBuffer.buffer, std::format("UploadRing_{}", static_cast<size_t>(&frameData - &_frameDates[0])));
+
+    frameData.uploadRing.Initialize(uploadBuffer);
+    frameData.objectCapacity = objectCapacity;
+
+    // Offsets into the ring are passed as dynamic offsets when binding, the descriptors only fix the ranges
+    VkDescriptorBufferInfo gpuCameraDataDescriptorBufferInfo = {};
+    gpuCameraDataDescriptorBufferInfo.buffer = uploadBuffer.buffer;
+    gpuCameraDataDescriptorBufferInfo.offset = 0;
+    gpuCameraDataDescriptorBufferInfo.range = sizeof(GpuCameraData);
+
+    VkWriteDescriptorSet gpuCameraDataWriteDescriptorSet = {};
+    gpuCameraDataWriteDescriptorSet.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    gpuCameraDataWriteDescriptorSet.pNext = nullptr;
+    gpuCameraDataWriteDescriptorSet.dstBinding = 0;
+    gpuCameraDataWriteDescriptorSet.dstSet = frameData.globalDescriptorSet;
+    gpuCameraDataWriteDescriptorSet.descriptorCount = 1;
+    gpuCameraDataWriteDescriptorSet.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    gpuCameraDataWriteDescriptorSet.pBufferInfo = &gpuCameraDataDescriptorBufferInfo;
+
+    VkDescriptorBufferInfo gpuSceneDataDescriptorBufferInfo = {};
+    gpuSceneDataDescriptorBufferInfo.buffer = uploadBuffer.buffer;
+    gpuSceneDataDescriptorBufferInfo.offset = 0;
+    gpuSceneDataDescriptorBufferInfo.range = sizeof(GpuSceneData);
+
+    VkWriteDescriptorSet gpuSceneDataWriteDescriptorSet = {};
+    gpuSceneDataWriteDescriptorSet.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    gpuSceneDataWriteDescriptorSet.pNext = nullptr;
+    gpuSceneDataWriteDescriptorSet.dstBinding = 1;
+    gpuSceneDataWriteDescriptorSet.dstSet = frameData.globalDescriptorSet;
+    gpuSceneDataWriteDescriptorSet.descriptorCount = 1;
+    gpuSceneDataWriteDescriptorSet.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    gpuSceneDataWriteDescriptorSet.pBufferInfo = &gpuSceneDataDescriptorBufferInfo;
+
+    VkDescriptorBufferInfo gpuObjectDataDescriptorBufferInfo = {};
+    gpuObjectDataDescriptorBufferInfo.buffer = uploadBuffer.buffer;
+    gpuObjectDataDescriptorBufferInfo.offset = 0;
+    gpuObjectDataDescriptorBufferInfo.range = objectDataSize;
+
+    VkWriteDescriptorSet gpuObjectDataWriteDescriptorSet = {};
+    gpuObjectDataWriteDescriptorSet.sType = VkStructureType::VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    gpuObjectDataWriteDescriptorSet.pNext = nullptr;
+    gpuObjectDataWriteDescriptorSet.dstBinding = 0;
+    gpuObjectDataWriteDescriptorSet.dstSet = frameData.objectDescriptorSet;
+    gpuObjectDataWriteDescriptorSet.descriptorCount = 1;
+    gpuObjectDataWriteDescriptorSet.descriptorType = VkDescriptorType::VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    gpuObjectDataWriteDescriptorSet.pBufferInfo = &gpuObjectDataDescriptorBufferInfo;
+
+    VkWriteDescriptorSet writeDescriptorSets[] =
+    {
+        gpuCameraDataWriteDescriptorSet,
+        gpuSceneDataWriteDescriptorSet,
+        gpuObjectDataWriteDescriptorSet
+    };
+
+    vkUpdateDescriptorSets(
+        _device,
+        3,
+        writeDescriptorSets,
+        0,
+        nullptr);
+
     return true;
 }
 
@@ -1312,21 +2446,230 @@ bool Engine::InitializeSynchronizationStructures()
     return true;
 }
 
+bool Engine::InitializeProfiler()
+{
+    // Tracy records its calibration commands into the upload command buffer
+    if (!_gpuProfiler.Initialize(
+        _physicalDevice,
+        _device,
+        _graphicsQueue,
+        _uploadContext.commandBuffer,
+        _physicalDeviceProperties.limits.timestampPeriod,
+        _graphicsQueueTimestampValidBits))
+    {
+        std::cerr << "GpuProfiler: Failed to initialize\n";
+        return false;
+    }
+
+    _deletionQueue.Push([=, this]()
+    {
+        _gpuProfiler.Destroy();
+    });
+
+    return true;
+}
+
+bool Engine::InitializeAsyncUploader()
+{
+    if (!_asyncUploader.Initialize(
+        _device,
+        _allocator,
+        _transferQueue,
+        _transferQueueFamily,
+        _graphicsQueueFamily))
+    {
+        std::cerr << "AsyncUploader: Failed to initialize\n";
+        return false;
+    }
+
+    _deletionQueue.Push([=, this]()
+    {
+        _asyncUploader.Destroy();
+    });
+
+    return true;
+}
+
+bool Engine::InitializeJobSystem()
+{
+    if (!_jobSystem.Initialize(_workerThreadCount))
+    {
+        std::cerr << "JobSystem: Failed to initialize\n";
+        return false;
+    }
+
+    _deletionQueue.Push([=, this]()
+    {
+        _jobSystem.Destroy();
+    });
+
+    return true;
+}
+
+bool Engine::InitializePipelineCache()
+{
+    // A missing or foreign cache file just means compiling from scratch this time
+    std::vector<std::byte> pipelineCacheData;
+    if (!_pipelineCachePath.empty())
+    {
+        auto pipelineCacheDataResult = ReadPipelineCacheData(_pipelineCachePath, _physicalDeviceProperties);
+        if (pipelineCacheDataResult.has_value())
+        {
+            pipelineCacheData = std::move(pipelineCacheDataResult.value());
+        }
+    }
+
+    if (vkCreatePipelineCache(
+        _device,
+        ToTempPtr(VkPipelineCacheCreateInfo
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pNext = nullptr,
+            .initialDataSize = pipelineCacheData.size(),
+            .pInitialData = pipelineCacheData.data(),
+        }),
+        nullptr,
+        &_pipelineCache) != VK_SUCCESS)
+    {
+        std::cerr << "Vulkan: Failed to create pipeline cache\n";
+        return false;
+    }
+
+    SetDebugName(_device, _pipelineCache, "PipelineCache");
+
+    _startupStatistics.isPipelineCacheWarm = !pipelineCacheData.empty();
+
+    _deletionQueue.Push([=, this]()
+    {
+        vkDestroyPipelineCache(_device, _pipelineCache, nullptr);
+    });
+
+    return true;
+}
+
+void Engine::SavePipelineCache()
+{
+    if (_pipelineCachePath.empty() || _pipelineCache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    size_t pipelineCacheDataSize = 0;
+    if (vkGetPipelineCacheData(_device, _pipelineCache, &pipelineCacheDataSize, nullptr) != VK_SUCCESS)
+    {
+        std::cerr << "Vulkan: Failed to get pipeline cache data size\n";
+        return;
+    }
+
+    std::vector<std::byte> pipelineCacheData(pipelineCacheDataSize);
+    if (vkGetPipelineCacheData(_device, _pipelineCache, &pipelineCacheDataSize, pipelineCacheData.data()) != VK_SUCCESS)
+    {
+        std::cerr << "Vulkan: Failed to get pipeline cache data\n";
+        return;
+    }
+
+    pipelineCacheData.resize(pipelineCacheDataSize);
+
+    auto writeResult = WritePipelineCacheData(_pipelineCachePath, _physicalDeviceProperties, pipelineCacheData);
+    if (!writeResult.has_value())
+    {
+        std::cerr << writeResult.error() << "\n";
+    }
+}
+
+bool Engine::InitializePipelineLibraryCache()
+{
+    if (!_pipelineLibraryCache.Initialize(_physicalDevice, _device, _pipelineCache, _isExtendedDynamicStateEnabled))
+    {
+        std::cerr << "PipelineLibraryCache: Failed to initialize\n";
+        return false;
+    }
+
+    _deletionQueue.Push([&]()
+    {
+        _pipelineLibraryCache.Destroy();
+    });
+
+    return true;
+}
+
+bool Engine::InitializePipelineCompiler()
+{
+    if (!_pipelineCompiler.Initialize(_device, _jobSystem, _pipelineLibraryCache, _optimizePipelinesInBackground))
+    {
+        std::cerr << "PipelineCompiler: Failed to initialize\n";
+        return false;
+    }
+
+    _deletionQueue.Push([&]()
+    {
+        _pipelineCompiler.Destroy();
+    });
+
+    return true;
+}
+
+bool Engine::InitializeGeometryPool()
+{
+    auto vertexBufferResult = CreateBuffer<VertexPositionNormalUv>(
+        "GeometryPoolVertexBuffer",
+        static_cast<VkDeviceSize>(_geometryPoolVertexCapacity) * GetVertexStride(_vertexFormat),
+        MemoryPlacement::DeviceLocal);
+    if (!vertexBufferResult.has_value())
+    {
+        std::cerr << vertexBufferResult.error() << "\n";
+        return false;
+    }
+
+    auto indexBufferResult = CreateBuffer<uint32_t>(
+        "GeometryPoolIndexBuffer",
+        static_cast<VkDeviceSize>(_geometryPoolIndexCapacity) * sizeof(uint32_t),
+        MemoryPlacement::DeviceLocal);
+    if (!indexBufferResult.has_value())
+    {
+        std::cerr << indexBufferResult.error() << "\n";
+        return false;
+    }
+
+    _geometryPool.Initialize(
+        vertexBufferResult.value(),
+        GetVertexStride(_vertexFormat),
+        indexBufferResult.value());
+
+    return true;
+}
+
 void Engine::Unload()
 {
+    // Loads still in flight have staging batches which only the uploader knows how to free once submitted
+    _jobSystem.Wait(_streamingCounter);
+    CommitStreamedModels();
+
     vkDeviceWaitIdle(_device);
 
+    SavePipelineCache();
+
     _deletionQueue.Flush();
     
-    for (size_t imageViewIndex = 0; imageViewIndex < _swapchainImageViews.size(); imageViewIndex++)
+    for (auto framebuffer : _framebuffers)
+    {
+        vkDestroyFramebuffer(_device, framebuffer, nullptr);
+    }
+
+    for (auto swapchainImageView : _swapchainImageViews)
     {
-        vkDestroyFramebuffer(_device, _framebuffers[imageViewIndex], nullptr);
-        vkDestroyImageView(_device, _swapchainImageViews[imageViewIndex], nullptr);
+        vkDestroyImageView(_device, swapchainImageView, nullptr);
     }
 
+    DestroyImage(_depthImage);
+    DestroyRetiredSwapchains(true);
+
     vmaDestroyAllocator(_allocator);    
 
-    vkDestroySurfaceKHR(_instance, _surface, nullptr);    
+    if (_surface != VK_NULL_HANDLE)
+    {
+        vkDestroySurfaceKHR(_instance, _surface, nullptr);
+    }
     vkDestroyDevice(_device, nullptr);
 
 #ifdef _DEBUG
@@ -1343,7 +2686,14 @@ void Engine::Unload()
 
 std::expected<VkShaderModule, std::string> Engine::LoadShaderModule(const std::string& filePath)
 {
-    auto buffer = ReadFile<uint32_t>(filePath);
+    // Mappings are page aligned, which satisfies the 4 byte alignment pCode needs
+    auto shaderFileResult = MappedFile::Open(filePath);
+    if (!shaderFileResult.has_value())
+    {
+        return std::unexpected(shaderFileResult.error());
+    }
+
+    auto& shaderFile = shaderFileResult.value();
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(
@@ -1352,8 +2702,8 @@ std::expected<VkShaderModule, std::string> Engine::LoadShaderModule(const std::s
         {
             .sType = VkStructureType::VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
             .pNext = nullptr,
-            .codeSize = buffer.size(),
-            .pCode = buffer.data()
+            .codeSize = shaderFile.GetSize(),
+            .pCode = reinterpret_cast<const uint32_t*>(shaderFile.GetData())
         }),
         nullptr,
          &shaderModule) != VK_SUCCESS)
@@ -1376,9 +2726,176 @@ GLFWwindow* Engine::GetWindow()
     return _window;
 }
 
-void Engine::DrawRenderables(VkCommandBuffer commandBuffer, Renderable* first, size_t count)
+void Engine::WaitForPendingUploads()
+{
+    // Helps decoding while waiting, the loads themselves only run on workers
+    _jobSystem.Wait(_streamingCounter);
+    CommitStreamedModels();
+    _pipelineCompiler.Wait();
+    _asyncUploader.WaitIdle();
+}
+
+bool Engine::IsHeadless() const
+{
+    return _headless;
+}
+
+bool Engine::IsMinimized() const
+{
+    if (_headless)
+    {
+        return false;
+    }
+
+    int32_t framebufferWidth = 0;
+    int32_t framebufferHeight = 0;
+    glfwGetFramebufferSize(_window, &framebufferWidth, &framebufferHeight);
+    return framebufferWidth == 0 || framebufferHeight == 0;
+}
+
+const GeometryStatistics& Engine::GetGeometryStatistics() const
+{
+    return _geometryStatistics;
+}
+
+StartupStatistics Engine::GetStartupStatistics() const
+{
+    auto startupStatistics = _startupStatistics;
+    startupStatistics.pipelineCompileTimeMs = _pipelineCompiler.GetCompileTimeMs();
+    startupStatistics.pipelineCount = _pipelineCompiler.GetCompiledPipelineCount();
+    return startupStatistics;
+}
+
+const FrameStatistics& Engine::GetFrameStatistics() const
+{
+    return _frameStatistics;
+}
+
+std::span<const GpuScopeTiming> Engine::GetGpuTimings() const
+{
+    return _gpuProfiler.GetTimings();
+}
+
+std::expected<ReadbackImage, std::string> Engine::ReadbackFrame()
+{
+    if (!_headless)
+    {
+        return std::unexpected("Engine: Readback is only supported in headless mode");
+    }
+
+    if (_frameIndex == 0)
+    {
+        return std::unexpected("Engine: No frame has been rendered yet");
+    }
+
+    auto& frameData = _frameDates[(_frameIndex - 1) % FRAMES_IN_FLIGHT];
+    if (vkWaitForFences(_device, 1, &frameData.renderFence, true, UINT64_MAX) != VK_SUCCESS)
+    {
+        return std::unexpected("Vulkan: Unable to wait for render fence");
+    }
+
+    SubmitImmediately([&](VkCommandBuffer commandBuffer)
+    {
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            1,
+            ToTempPtr(VkImageMemoryBarrier
+            {
+                .sType = VkStructureType::VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VkAccessFlagBits::VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                .dstAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_READ_BIT,
+                .oldLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .newLayout = VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = frameData.offscreenImage.image,
+                .subresourceRange = VkImageSubresourceRange
+                {
+                    .aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                }
+            }));
+
+        vkCmdCopyImageToBuffer(
+            commandBuffer,
+            frameData.offscreenImage.image,
+            VkImageLayout::VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            _readbackBuffer.buffer,
+            1,
+            ToTempPtr(VkBufferImageCopy
+            {
+                .bufferOffset = 0,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = VkImageSubresourceLayers
+                {
+                    .aspectMask = VkImageAspectFlagBits::VK_IMAGE_ASPECT_COLOR_BIT,
+                    .mipLevel = 0,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+                .imageOffset = { 0, 0, 0 },
+                .imageExtent = { _windowExtent.width, _windowExtent.height, 1 }
+            }));
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VkPipelineStageFlagBits::VK_PIPELINE_STAGE_HOST_BIT,
+            0,
+            0,
+            nullptr,
+            1,
+            ToTempPtr(VkBufferMemoryBarrier
+            {
+                .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                .pNext = nullptr,
+                .srcAccessMask = VkAccessFlagBits::VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VkAccessFlagBits::VK_ACCESS_HOST_READ_BIT,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = _readbackBuffer.buffer,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE
+            }),
+            0,
+            nullptr);
+    });
+
+    ReadbackImage readbackImage;
+    readbackImage.width = _windowExtent.width;
+    readbackImage.height = _windowExtent.height;
+    readbackImage.format = _offscreenImageFormat;
+    readbackImage.pixels.resize(_readbackBuffer.bufferSize);
+
+    // HostReadback buffers stay mapped, only non-coherent memory needs the transfer's writes invalidated
+    VkMemoryPropertyFlags readbackMemoryProperties = 0;
+    vmaGetAllocationMemoryProperties(_allocator, _readbackBuffer.allocation, &readbackMemoryProperties);
+    if ((readbackMemoryProperties & VkMemoryPropertyFlagBits::VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+    {
+        vmaInvalidateAllocation(_allocator, _readbackBuffer.allocation, 0, VK_WHOLE_SIZE);
+    }
+
+    memcpy(readbackImage.pixels.data(), _readbackBuffer.mappedData, readbackImage.pixels.size());
+
+    return readbackImage;
+}
+
+bool Engine::DrawRenderables(VkCommandBuffer commandBuffer, Renderable* first, size_t count)
 {
-    GpuPushConstants pushConstants;
+    ZoneScoped;
+    GPU_PROFILE_SCOPE(_gpuProfiler, commandBuffer, "DrawRenderables");
 
     GpuCameraData gpuCameraData;
     gpuCameraData.projectionMatrix = glm::perspectiveFov(glm::pi<float>() / 2.0f, (float)_windowExtent.width, (float)_windowExtent.height, 0.1f, 512.0f);
@@ -1387,70 +2904,164 @@ void Engine::DrawRenderables(VkCommandBuffer commandBuffer, Renderable* first, s
 
     auto& currentFrame = GetCurrentFrameData();
 
-    void* gpuCameraDataPtr = nullptr;
-    if (vmaMapMemory(_allocator, currentFrame.cameraBuffer.allocation, &gpuCameraDataPtr) == VK_SUCCESS)
+    if (!EnsureObjectCapacity(currentFrame, count))
     {
-        memcpy(gpuCameraDataPtr, &gpuCameraData, sizeof(GpuCameraData));
-        vmaUnmapMemory(_allocator, currentFrame.cameraBuffer.allocation);
+        return false;
     }
 
+    auto& uploadRing = currentFrame.uploadRing;
+    uploadRing.Reset();
+
     float arbitraryValue = (_frameIndex / 120.f);
     _gpuSceneData.ambientColor = { sin(arbitraryValue), 0, cos(arbitraryValue), 1 };
 
-	char* gpuSceneDataPtr = {};
-	if (vmaMapMemory(_allocator, _gpuSceneDataBuffer.allocation, (void**)&gpuSceneDataPtr) == VK_SUCCESS)
-    {
-	    uint32_t frameIndex = _frameIndex % FRAMES_IN_FLIGHT;
-    	gpuSceneDataPtr += PadUniformBufferSize(sizeof(GpuSceneData)) * frameIndex;
+    auto uniformAlignment = _physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+    auto storageAlignment = _physicalDeviceProperties.limits.minStorageBufferOffsetAlignment;
 
-        memcpy(gpuSceneDataPtr, &_gpuSceneData, sizeof(GpuSceneData));
-        vmaUnmapMemory(_allocator, _gpuSceneDataBuffer.allocation);    
+    auto gpuCameraDataAllocation = uploadRing.Upload(gpuCameraData, uniformAlignment);
+    auto gpuSceneDataAllocation = uploadRing.Upload(_gpuSceneData, uniformAlignment);
+    // the object descriptor's range always covers the full capacity, so that much is reserved
+    auto gpuObjectDataAllocation = uploadRing.Allocate(currentFrame.objectCapacity * sizeof(GpuObjectData), storageAlignment);
+    auto drawCommandAllocation = uploadRing.Allocate(count * sizeof(VkDrawIndexedIndirectCommand), sizeof(uint32_t));
+    if (!gpuCameraDataAllocation || !gpuSceneDataAllocation || !gpuObjectDataAllocation || !drawCommandAllocation)
+    {
+        std::cerr << "Engine: Unable to allocate frame data from the upload ring\n";
+        return false;
     }
 
-    void* objectDataPtr = nullptr;
-    if (vmaMapMemory(_allocator, currentFrame.objectBuffer.allocation, &objectDataPtr) == VK_SUCCESS)
+    auto gpuObjectDates = static_cast<GpuObjectData*>(gpuObjectDataAllocation->data);
+    auto drawCommands = static_cast<VkDrawIndexedIndirectCommand*>(drawCommandAllocation->data);
+
+    uint32_t globalDynamicOffsets[] =
     {
-        GpuObjectData* gpuObjectDates = (GpuObjectData*)objectDataPtr;
-        for (size_t i = 0; i < count; i++)
+        static_cast<uint32_t>(gpuCameraDataAllocation->offset),
+        static_cast<uint32_t>(gpuSceneDataAllocation->offset)
+    };
+    auto objectDynamicOffset = static_cast<uint32_t>(gpuObjectDataAllocation->offset);
+
+    // Renderables are sorted by pipeline, index type and mesh, consecutive renderables of the same mesh
+    // become instances of one draw command whose firstInstance is their first object, the shaders index
+    // objects with gl_InstanceIndex, which starts there and advances per instance.
+    // Draw commands which share a pipeline and index type are submitted with a single indirect call
+    uint32_t drawCount = 0;
+    uint32_t firstPendingDraw = 0;
+    auto flushPendingDraws = [&]()
+    {
+        if (drawCount > firstPendingDraw)
         {
-            auto& renderable = first[i];
-            //std::cout << "\nMesh: " << renderable.mesh->name << "\n" << glm::to_string(renderable.worldMatrix) << "\n";
-            gpuObjectDates[i].worldMatrix = renderable.worldMatrix;
+            GPU_PROFILE_SCOPE(_gpuProfiler, commandBuffer, "DrawBatch");
+            vkCmdDrawIndexedIndirect(
+                commandBuffer,
+                uploadRing.GetBuffer().buffer,
+                drawCommandAllocation->offset + firstPendingDraw * sizeof(VkDrawIndexedIndirectCommand),
+                drawCount - firstPendingDraw,
+                sizeof(VkDrawIndexedIndirectCommand));
+            firstPendingDraw = drawCount;
         }
-        vmaUnmapMemory(_allocator, currentFrame.objectBuffer.allocation);
-    }
+    };
+
+    // Every mesh lives in the geometry pool, so vertices are bound once for the whole frame
+    // and the index buffer once per index type
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &_geometryPool.GetVertexBuffer().buffer, &offset);
+
+    // Pipelines leave viewport and scissor to the command buffer, so they do not depend on the window's size.
+    // The viewport is flipped to keep y pointing up
+    vkCmdSetViewport(commandBuffer, 0, 1, ToTempPtr(VkViewport
+    {
+        .x = 0,
+        .y = (float)_windowExtent.height,
+        .width = (float)_windowExtent.width,
+        .height = -(float)_windowExtent.height,
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f
+    }));
+    vkCmdSetScissor(commandBuffer, 0, 1, ToTempPtr(VkRect2D
+    {
+        .offset = { 0, 0 },
+        .extent = _windowExtent
+    }));
+    auto boundIndexType = VkIndexType::VK_INDEX_TYPE_MAX_ENUM;
 
     Mesh* lastMesh = nullptr;
-    Pipeline* lastPipeline = nullptr;
+    const Pipeline* lastPipeline = nullptr;
     for (size_t i = 0; i < count; i++)
     {
         auto& renderable = first[i];
+        gpuObjectDates[i].worldMatrix = renderable.worldMatrix;
+        if (renderable.mesh->vertexFormat == VertexFormat::PackedPositionNormalUv)
+        {
+            // Dequantizing packed positions is folded into the world matrix
+            gpuObjectDates[i].worldMatrix *= glm::translate(renderable.mesh->positionOffset) * glm::scale(renderable.mesh->positionScale);
+        }
+
+        if (renderable.mesh->uploadTicket > _residentUploadTicket)
+        {
+            continue;
+        }
 
-        if (lastPipeline == nullptr || lastPipeline->pipeline != renderable.pipeline.pipeline)
+        // Still compiling
+        auto pipeline = _pipelineCompiler.GetPipeline(renderable.pipeline);
+        if (pipeline == nullptr)
         {
-            vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, renderable.pipeline.pipeline);
-            lastPipeline = &renderable.pipeline;
+            continue;
+        }
 
-            uint32_t dynamicOffset = PadUniformBufferSize(sizeof(GpuSceneData)) * i;
-            vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->pipelineLayout, 0, 1, &currentFrame.globalDescriptorSet, 1, &dynamicOffset);
-            vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->pipelineLayout, 1, 1, &currentFrame.objectDescriptorSet, 0, nullptr);
+        // Skipped renderables leave gaps, an instance only joins the last command when its object is the next one
+        auto isSamePipeline = lastPipeline == pipeline;
+        if (isSamePipeline && renderable.mesh == lastMesh)
+        {
+            auto& lastDrawCommand = drawCommands[drawCount - 1];
+            if (lastDrawCommand.firstInstance + lastDrawCommand.instanceCount == i)
+            {
+                lastDrawCommand.instanceCount++;
+                continue;
+            }
         }
 
-        if (renderable.mesh != lastMesh)
+        if (!isSamePipeline)
         {
-            VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &renderable.mesh->vertexBuffer.buffer, &offset);
-            vkCmdBindIndexBuffer(commandBuffer, renderable.mesh->indexBuffer.buffer, offset, VkIndexType::VK_INDEX_TYPE_UINT32);
-            lastMesh = renderable.mesh;
+            flushPendingDraws();
+
+            vkCmdBindPipeline(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->pipeline);
+            lastPipeline = pipeline;
+
+            vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->pipelineLayout, 0, 1, &currentFrame.globalDescriptorSet, 2, globalDynamicOffsets);
+            vkCmdBindDescriptorSets(commandBuffer, VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS, lastPipeline->pipelineLayout, 1, 1, &currentFrame.objectDescriptorSet, 1, &objectDynamicOffset);
         }
 
-        pushConstants.worldMatrix = renderable.worldMatrix;
-        vkCmdPushConstants(commandBuffer, renderable.pipeline.pipelineLayout, VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GpuPushConstants), &pushConstants);
+        if (renderable.mesh->indexType != boundIndexType)
+        {
+            // Indirect draws use whatever index type is bound when they are recorded
+            flushPendingDraws();
+
+            boundIndexType = renderable.mesh->indexType;
+            vkCmdBindIndexBuffer(commandBuffer, _geometryPool.GetIndexBuffer().buffer, 0, boundIndexType);
+        }
 
-        vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(renderable.mesh->indices.size()), 1, 0, 0, 0);
+        lastMesh = renderable.mesh;
+        drawCommands[drawCount++] = VkDrawIndexedIndirectCommand
+        {
+            .indexCount = renderable.mesh->indexCount,
+            .instanceCount = 1,
+            .firstIndex = renderable.mesh->firstIndex,
+            .vertexOffset = renderable.mesh->vertexOffset,
+            .firstInstance = static_cast<uint32_t>(i)
+        };
     }
 
-    vkCmdDrawIndexed(commandBuffer, lastMesh->indices.size(), count, 0, 0, 0);
+    flushPendingDraws();
+
+    // no-op unless the placement ended up in non-coherent memory
+    vmaFlushAllocation(_allocator, uploadRing.GetBuffer().allocation, 0, uploadRing.GetUsedSize());
+
+    _frameStatistics.uploadedBytes =
+        sizeof(GpuCameraData) +
+        sizeof(GpuSceneData) +
+        count * sizeof(GpuObjectData) +
+        drawCount * sizeof(VkDrawIndexedIndirectCommand);
+
+    return true;
 }
 
 std::vector<Mesh*> Engine::GetModel(const std::string& name)
@@ -1500,6 +3111,17 @@ size_t Engine::PadUniformBufferSize(size_t originalSize)
     return alignedSize;
 }
 
+size_t Engine::PadStorageBufferSize(size_t originalSize)
+{
+    size_t minSsboAlignment = _physicalDeviceProperties.limits.minStorageBufferOffsetAlignment;
+    size_t alignedSize = originalSize;
+    if (minSsboAlignment > 0)
+    {
+        alignedSize = (alignedSize + minSsboAlignment - 1) & ~(minSsboAlignment - 1);
+    }
+    return alignedSize;
+}
+
 VkCommandBufferBeginInfo Engine::CreateCommandBufferBeginInfo(VkCommandBufferUsageFlags flags)
 {
     VkCommandBufferBeginInfo commandBufferBeginInfo = {};
@@ -16,44 +16,155 @@
 #include <cstdint>
 #include <string>
 #include <expected>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
 #include <unordered_map>
 
+#include "DebugName.hpp"
 #include "DeletionQueue.hpp"
 #include "Types.hpp"
 #include "Pipeline.hpp"
+#include "PipelineLibrary.hpp"
+#include "PipelineCompiler.hpp"
 #include "Mesh.hpp"
 #include "Renderable.hpp"
 #include "FrameData.hpp"
 #include "UploadContext.hpp"
+#include "GpuProfiler.hpp"
+#include "GeometryPool.hpp"
+#include "AsyncUploader.hpp"
+#include "JobSystem.hpp"
+#include "GeometryOptimizer.hpp"
+#include "MeshCache.hpp"
 
 constexpr uint32_t FRAMES_IN_FLIGHT = 2;
+constexpr uint32_t INITIAL_OBJECT_CAPACITY = 128;
 
-template<typename T>
-void SetDebugName(VkDevice device, T object, const std::string& debugName)
+struct EngineOptions
 {
-#ifdef _DEBUG
-    const VkDebugUtilsObjectNameInfoEXT debugUtilsObjectNameInfo =
-    {
-        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT,
-        .pNext = NULL,
-        .objectType = VulkanObjectType<T>::objectType,
-        .objectHandle = (uint64_t)object,
-        .pObjectName = debugName.c_str(),
-    };
-
-    vkSetDebugUtilsObjectNameEXT(device, &debugUtilsObjectNameInfo);
-#endif
-}
+    // Renders into offscreen images instead of a window and swapchain
+    bool headless = false;
+    VkExtent2D headlessExtent = {1920, 1080};
+    // How many copies of the test model Load lays out in the scene
+    uint32_t sceneReplicaCount = 3;
+    // Capacity of the vertex and index buffers all meshes are suballocated from,
+    // the index capacity is counted in 32 bit indices
+    uint32_t geometryPoolVertexCapacity = 1u << 21;
+    uint32_t geometryPoolIndexCapacity = 1u << 23;
+    // Camera, scene and object data is read per vertex, ReBar keeps those reads out of system memory
+    MemoryPlacement frameDataPlacement = MemoryPlacement::ReBar;
+    // Meshes drop their vertices and indices once staged, keep them for picking or collision
+    bool keepCpuGeometry = false;
+    // PackedPositionNormalUv halves vertex fetch bandwidth at 16 instead of 32 bytes per vertex
+    VertexFormat vertexFormat = VertexFormat::PositionNormalUv;
+    // Reorders triangles and vertices for the post-transform cache, vertex fetch and overdraw while loading
+    bool optimizeGeometry = false;
+    // Where models are cooked to on first load and read back from on later ones, empty disables the cache.
+    // Not used while keepCpuGeometry is set, the cache only holds what the GPU needs
+    std::string meshCacheDirectory = "cache";
+    // Compiled pipelines are kept here between runs, empty disables it
+    std::string pipelineCachePath = "cache/pipelines.bin";
+    // Pipelines are fast linked from cached library parts, this links them again with link time
+    // optimization on a worker and swaps them in once done
+    bool optimizePipelinesInBackground = true;
+    // Threads the JobSystem spawns, 0 means one per hardware thread besides the main thread
+    uint32_t workerThreadCount = 0;
+};
+
+struct FrameStatistics
+{
+    double cpuFrameTimeMs = 0.0;
+    double fenceWaitTimeMs = 0.0;
+    double recordTimeMs = 0.0;
+    double submitTimeMs = 0.0;
+    // Measured with timestamp queries, lags behind by FRAMES_IN_FLIGHT frames
+    double gpuTimeMs = 0.0;
+    // The GPU took longer than the CPU spent on the frame outside of waiting for it
+    bool isGpuBound = false;
+    // Camera, scene, object data and draw commands written to the frame's upload ring
+    uint64_t uploadedBytes = 0;
+    // False when Draw returned without submitting, because the window is minimized or the swapchain
+    // is out of date. Everything else still describes the last rendered frame then
+    bool isRendered = false;
+};
+
+// Post-transform vertex cache behaviour of the loaded geometry, simulated with a VERTEX_CACHE_SIZE entry FIFO.
+// Only collected for optimized geometry. Hit rate is 1 - transformed / (3 * triangles)
+struct GeometryStatistics
+{
+    uint64_t triangleCount = 0;
+    uint64_t transformedVertexCountBefore = 0;
+    uint64_t transformedVertexCountAfter = 0;
+};
+
+// A model decoded and staged on a background worker, waiting for the main thread to submit its upload
+// and make its meshes visible
+struct StreamedModel
+{
+    std::string modelName;
+    std::vector<std::pair<std::string, Mesh>> meshes;
+    std::optional<UploadBatch> uploadBatch;
+    GeometryStatistics geometryStatistics;
+    std::function<void(const std::string& modelName)> onLoaded;
+};
+
+struct StartupStatistics
+{
+    // Time workers spent compiling pipelines, summed over all of them
+    double pipelineCompileTimeMs = 0.0;
+    uint32_t pipelineCount = 0;
+    // The pipeline cache was loaded from disk, so pipelines were likely not compiled from scratch
+    bool isPipelineCacheWarm = false;
+};
+
+// What a swapchain recreation replaced. Frames up to lastFrameIndex may still render to it, it is
+// destroyed once their fences signaled
+struct RetiredSwapchain
+{
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    std::vector<VkImageView> imageViews;
+    std::vector<VkFramebuffer> framebuffers;
+    AllocatedImage depthImage;
+    int32_t lastFrameIndex = 0;
+};
+
+struct ReadbackImage
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    std::vector<uint8_t> pixels;
+};
 
 class Engine
 {
 public:
-    bool Initialize();
+    bool Initialize(const EngineOptions& options = {});
     bool Load();
     bool Draw();
     void Unload();
 
     GLFWwindow* GetWindow();
+    bool IsHeadless() const;
+    // Draw skips frames while there is nothing to present to
+    bool IsMinimized() const;
+    const FrameStatistics& GetFrameStatistics() const;
+    const GeometryStatistics& GetGeometryStatistics() const;
+    StartupStatistics GetStartupStatistics() const;
+    std::span<const GpuScopeTiming> GetGpuTimings() const;
+
+    std::expected<ReadbackImage, std::string> ReadbackFrame();
+    // Loads the model on a background worker and returns right away. Draw commits it once it is ready,
+    // then its meshes are returned by GetModel and onLoaded runs on the main thread
+    void RequestModel(
+        const std::string& modelName,
+        const std::string& filePath,
+        std::function<void(const std::string& modelName)>&& onLoaded = {});
+    // Blocks until every requested model has been loaded and committed, every mesh has been copied and
+    // every pipeline is in its final optimized form, they become drawable with the next Draw
+    void WaitForPendingUploads();
 
     Mesh* GetMesh(const std::string& name);
     std::vector<Mesh*> GetModel(const std::string& name);
@@ -66,6 +177,12 @@ private:
     int32_t _frameIndex{0};
     VkExtent2D _windowExtent{1920, 1080};
     bool _vsync{true};
+    bool _headless{false};
+    uint32_t _sceneReplicaCount{3};
+    FrameStatistics _frameStatistics;
+    GeometryStatistics _geometryStatistics;
+    StartupStatistics _startupStatistics;
+    GpuProfiler _gpuProfiler;
     std::string _windowTitle{"Fuk"};
     DeletionQueue _deletionQueue;
 
@@ -77,18 +194,30 @@ private:
     VkPhysicalDevice _physicalDevice;
     VkPhysicalDeviceProperties _physicalDeviceProperties;
     VkDevice _device;
-    VkSurfaceKHR _surface;
+    bool _isExtendedDynamicStateEnabled{false};
+    VkSurfaceKHR _surface = {};
 
     VkSwapchainKHR _swapchain;
     VkFormat _swapchainImageFormat;
     std::vector<VkImage> _swapchainImages;
     std::vector<VkImageView> _swapchainImageViews;
+    // Set on resize and whenever acquire or present report the swapchain no longer matches the surface
+    bool _isSwapchainOutOfDate{false};
+    std::vector<RetiredSwapchain> _retiredSwapchains;
+
+    VkFormat _offscreenImageFormat{VK_FORMAT_R8G8B8A8_UNORM};
+    AllocatedBuffer _readbackBuffer;
 
     AllocatedImage _depthImage;
     VkFormat _depthFormat;
 
     VkQueue _graphicsQueue;
     uint32_t _graphicsQueueFamily;
+    // 0 when the graphics queue can not write timestamps, GPU timings are off then
+    uint32_t _graphicsQueueTimestampValidBits{0};
+    // Dedicated when the device has one, otherwise whatever queue vk-bootstrap finds for transfers
+    VkQueue _transferQueue;
+    uint32_t _transferQueueFamily;
 
     VkRenderPass _renderPass;
     std::vector<VkFramebuffer> _framebuffers;
@@ -102,10 +231,40 @@ private:
 
     VmaAllocator _allocator;
 
-    VkPipeline _meshPipeline;
+    PipelineHandle _meshPipeline{INVALID_PIPELINE_HANDLE};
+
+    std::string _pipelineCachePath{"cache/pipelines.bin"};
+    VkPipelineCache _pipelineCache{VK_NULL_HANDLE};
+    PipelineLibraryCache _pipelineLibraryCache;
+    bool _optimizePipelinesInBackground{true};
+    PipelineCompiler _pipelineCompiler;
+
+    uint32_t _geometryPoolVertexCapacity{1u << 21};
+    uint32_t _geometryPoolIndexCapacity{1u << 23};
+    GeometryPool _geometryPool;
+    // Models loading in the background allocate from the pool concurrently
+    std::mutex _geometryPoolMutex;
+
+    MemoryPlacement _frameDataPlacement{MemoryPlacement::ReBar};
+    bool _keepCpuGeometry{false};
+
+    VertexFormat _vertexFormat{VertexFormat::PositionNormalUv};
+    bool _optimizeGeometry{false};
+    GeometryOptimizationCache _geometryOptimizationCache;
+    std::string _meshCacheDirectory{"cache"};
+
+    uint32_t _workerThreadCount{0};
+    JobSystem _jobSystem;
+
+    JobCounter _streamingCounter;
+    std::mutex _streamedModelsMutex;
+    std::vector<StreamedModel> _streamedModels;
+
+    AsyncUploader _asyncUploader;
+    // Highest upload ticket the graphics queue has acquired, meshes up to it can be drawn
+    uint64_t _residentUploadTicket{0};
 
     GpuSceneData _gpuSceneData;
-    AllocatedBuffer _gpuSceneDataBuffer;
 
     FrameData _frameDates[FRAMES_IN_FLIGHT];
     FrameData& GetCurrentFrameData();
@@ -114,55 +273,16 @@ private:
     void SubmitImmediately(std::function<void(VkCommandBuffer cmd)>&& function);
 
     size_t PadUniformBufferSize(size_t originalSize);
-
-    template<typename TData>
-    std::expected<AllocatedBuffer, std::string> CreateStagingBuffer(std::span<TData> data)
-    {
-        AllocatedBuffer buffer;
-        buffer.bufferSize = data.size() * sizeof(TData);
-        if (vmaCreateBuffer(
-            _allocator,
-            ToTempPtr(VkBufferCreateInfo
-            {
-                .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-                .size = buffer.bufferSize,
-                .usage = VkBufferUsageFlagBits::VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-            }),
-            ToTempPtr(VmaAllocationCreateInfo
-            {
-                .usage = VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY
-            }),
-            &buffer.buffer,
-            &buffer.allocation,
-            nullptr) != VK_SUCCESS)
-        {
-            return std::unexpected("Vulkan: Failed to create staging buffer");
-        }
-
-        void* dataPtr = nullptr;
-        if (vmaMapMemory(_allocator, buffer.allocation, &dataPtr) != VK_SUCCESS)
-        {
-            return std::unexpected("Vulkan: Failed to map staging buffer");
-        }
-
-        memcpy(dataPtr, data.data(), buffer.bufferSize);
-        vmaUnmapMemory(_allocator, buffer.allocation);    
-
-        _deletionQueue.Push([=, this]()
-        {
-            vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
-        });
-
-        return buffer;
-    }
+    size_t PadStorageBufferSize(size_t originalSize);
 
     template<typename TData>
     std::expected<AllocatedBuffer, std::string> CreateBuffer(
         const std::string& label,
-        VmaMemoryUsage memoryUsage,
+        MemoryPlacement memoryPlacement,
         std::span<TData> data)
     {
         AllocatedBuffer buffer;
+        VmaAllocationInfo allocationInfo = {};
         buffer.bufferSize = data.size() * sizeof(TData);
         if (vmaCreateBuffer(
             _allocator,
@@ -170,35 +290,33 @@ private:
             {
                 .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                 .size = buffer.bufferSize,
-                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-            }),
-            ToTempPtr(VmaAllocationCreateInfo
-            {
-                .usage = memoryUsage
+                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
             }),
+            ToTempPtr(ToAllocationCreateInfo(memoryPlacement)),
             &buffer.buffer,
             &buffer.allocation,
-            nullptr) != VK_SUCCESS)
+            &allocationInfo) != VK_SUCCESS)
         {
             return std::unexpected("Vulkan: Failed to create buffer");
         }
 
-        SetDebugName(_device, buffer.buffer, label);
-
-        void* dataPtr = nullptr;
-        if (vmaMapMemory(_allocator, buffer.allocation, &dataPtr) != VK_SUCCESS)
-        {
-            return std::unexpected("Vulkan: Failed to map buffer");
-        }
+        buffer.mappedData = allocationInfo.pMappedData;
 
-        memcpy(dataPtr, data.data(), data.size() * sizeof(TData));
-        vmaUnmapMemory(_allocator, buffer.allocation);    
+        SetDebugName(_device, buffer.buffer, label);
 
         _deletionQueue.Push([=, this]()
         {
             vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
         });
 
+        // Device local buffers are filled through the AsyncUploader
+        if (buffer.mappedData == nullptr)
+        {
+            return std::unexpected("Vulkan: Buffer is not host visible, stage its data instead");
+        }
+
+        memcpy(buffer.mappedData, data.data(), data.size() * sizeof(TData));
+
         return buffer;
     }
 
@@ -206,28 +324,29 @@ private:
     std::expected<AllocatedBuffer, std::string> CreateBuffer(
         const std::string& label,
         VkDeviceSize dataSize,
-        VmaMemoryUsage memoryUsage)
+        MemoryPlacement memoryPlacement)
     {
         AllocatedBuffer buffer;
+        VmaAllocationInfo allocationInfo = {};
+        buffer.bufferSize = dataSize;
         if (vmaCreateBuffer(
             _allocator,
             ToTempPtr(VkBufferCreateInfo
             {
                 .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                 .size = dataSize,
-                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-            }),
-            ToTempPtr(VmaAllocationCreateInfo
-            {
-                .usage = memoryUsage
+                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
             }),
+            ToTempPtr(ToAllocationCreateInfo(memoryPlacement)),
             &buffer.buffer,
             &buffer.allocation,
-            nullptr) != VK_SUCCESS)
+            &allocationInfo) != VK_SUCCESS)
         {
             return std::unexpected("Vulkan: Failed to create buffer");
         }
 
+        buffer.mappedData = allocationInfo.pMappedData;
+
         SetDebugName(_device, buffer.buffer, label);
 
         _deletionQueue.Push([=, this]()
@@ -241,28 +360,29 @@ private:
     template<typename TData>
     std::expected<AllocatedBuffer, std::string> CreateBuffer(
         const std::string& label,
-        VmaMemoryUsage memoryUsage)
+        MemoryPlacement memoryPlacement)
     {
         AllocatedBuffer buffer;
+        buffer.bufferSize = sizeof(TData);
+        VmaAllocationInfo allocationInfo = {};
         if (vmaCreateBuffer(
             _allocator,
             ToTempPtr(VkBufferCreateInfo
             {
                 .sType = VkStructureType::VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                 .size = sizeof(TData),
-                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-            }),
-            ToTempPtr(VmaAllocationCreateInfo
-            {
-                .usage = memoryUsage
+                .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
             }),
+            ToTempPtr(ToAllocationCreateInfo(memoryPlacement)),
             &buffer.buffer,
             &buffer.allocation,
-            nullptr) != VK_SUCCESS)
+            &allocationInfo) != VK_SUCCESS)
         {
             return std::unexpected("Vulkan: Failed to create buffer");
         }
 
+        buffer.mappedData = allocationInfo.pMappedData;
+
         SetDebugName(_device, buffer.buffer, label);
 
         _deletionQueue.Push([=, this]()
@@ -273,26 +393,55 @@ private:
         return buffer;
     }
 
+    // Images recreated on resize leave isOwnedByDeletionQueue false and are destroyed with DestroyImage
     std::expected<AllocatedImage, std::string> CreateImage(
         const std::string& label,
         VkFormat format,
         VkImageUsageFlags imageUsageFlags,
         VkImageAspectFlags imageAspectFlags,
-        VkExtent3D extent);
+        VkExtent3D extent,
+        bool isOwnedByDeletionQueue = true);
+    void DestroyImage(const AllocatedImage& image);
 
+    bool InitializeWindow();
     bool InitializeVulkan();
     bool InitializeSwapchain();
+    bool CreateSwapchain(VkSwapchainKHR oldSwapchain);
+    bool InitializeDepthImage();
+    // Builds a new swapchain from the old one and retires the old targets, without waiting for the device.
+    // Leaves the swapchain out of date while the window is minimized
+    bool RecreateSwapchain();
+    void DestroyRetiredSwapchains(bool isDeviceIdle);
+    bool InitializeOffscreenTargets();
     bool InitializeCommandBuffers();
     bool InitializeRenderPass();
     bool InitializeFramebuffers();
     bool InitializeDescriptors();
     bool InitializeSynchronizationStructures();
-
-    bool LoadMeshFromFile(const std::string& modelName, const std::string& filePath);
+    bool InitializeProfiler();
+    bool InitializeGeometryPool();
+    bool InitializeAsyncUploader();
+    bool InitializeJobSystem();
+    bool InitializePipelineCache();
+    void SavePipelineCache();
+    bool InitializePipelineLibraryCache();
+    bool InitializePipelineCompiler();
+
+    bool EnsureObjectCapacity(FrameData& frameData, size_t objectCount);
+
+    // Safe to call from workers, they only touch the geometry pool under its mutex
+    bool LoadMeshFromFile(const std::string& filePath, StreamedModel& streamedModel);
+    bool LoadMeshFromCache(const std::filesystem::path& meshCachePath, MeshCacheContents& meshCacheContents, StreamedModel& streamedModel);
+    bool CommitStreamedModels();
+    void RegisterModel(const std::string& modelName, std::vector<std::pair<std::string, Mesh>>& meshes, uint64_t uploadTicket);
+    // DrawRenderables merges neighbouring renderables of the same pipeline and mesh into one instanced draw,
+    // and has to split indirect batches whenever the index type changes, so renderables are kept in that order
+    void SortRenderables();
 
     std::expected<VkShaderModule, std::string> LoadShaderModule(const std::string& filePath);
 
-    void DrawRenderables(VkCommandBuffer commandBuffer, Renderable* first, size_t count);
+    // False when the frame's object or upload ring memory could not be had, the frame has to fail then
+    bool DrawRenderables(VkCommandBuffer commandBuffer, Renderable* first, size_t count);
 
     VkCommandBufferBeginInfo CreateCommandBufferBeginInfo(VkCommandBufferUsageFlags flags = 0);
     VkSubmitInfo CreateSubmitInfo(VkCommandBuffer* commandBuffer);
@@ -3,6 +3,8 @@
 #include <volk.h>
 
 #include "Types.hpp"
+#include "GpuProfiler.hpp"
+#include "UploadRing.hpp"
 
 struct FrameData
 {
@@ -13,9 +15,15 @@ struct FrameData
     VkCommandPool commandPool = {};
     VkCommandBuffer commandBuffer = {};
 
-    AllocatedBuffer cameraBuffer = {};
-    VkDescriptorSet globalDescriptorSet;
+    GpuTimestampQueries timestampQueries = {};
 
-    AllocatedBuffer objectBuffer = {};
+    // Camera, scene, object data and indirect draw commands of the frame,
+    // grows when the frame draws more objects than it can hold
+    UploadRing uploadRing = {};
+    size_t objectCapacity = 0;
+    VkDescriptorSet globalDescriptorSet;
     VkDescriptorSet objectDescriptorSet;
+
+    // Only used in headless mode, takes the place of the swapchain image
+    AllocatedImage offscreenImage = {};
 };
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "GeometryOptimizer.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include <glm/geometric.hpp>
+
+std::vector<uint32_t> OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+    auto triangleCount = indices.size() / 3;
+
+    // Triangles adjacent to each vertex, as ranges of one flat array
+    std::vector<uint32_t> liveTriangleCounts(vertexCount, 0);
+    for (auto index : indices)
+    {
+        liveTriangleCounts[index]++;
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        adjacencyOffsets[vertex + 1] = adjacencyOffsets[vertex] + liveTriangleCounts[vertex];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> adjacencyCursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t triangle = 0; triangle < triangleCount; triangle++)
+        {
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                adjacency[adjacencyCursors[indices[triangle * 3 + corner]]++] = static_cast<uint32_t>(triangle);
+            }
+        }
+    }
+
+    // A vertex is in the cache while fewer than cacheSize vertices entered it after its timestamp
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+
+    std::vector<bool> isTriangleEmitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> optimizedIndices;
+    optimizedIndices.reserve(triangleCount * 3);
+    std::vector<uint32_t> clusters;
+
+    size_t nextUnvisitedVertex = 0;
+    auto skipDeadEnd = [&]() -> int64_t
+    {
+        while (!deadEnds.empty())
+        {
+            auto vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangleCounts[vertex] > 0)
+            {
+                return vertex;
+            }
+        }
+
+        for (; nextUnvisitedVertex < vertexCount; nextUnvisitedVertex++)
+        {
+            if (liveTriangleCounts[nextUnvisitedVertex] > 0)
+            {
+                return static_cast<int64_t>(nextUnvisitedVertex);
+            }
+        }
+
+        return -1;
+    };
+
+    auto fanningVertex = skipDeadEnd();
+    if (fanningVertex >= 0)
+    {
+        clusters.push_back(0);
+    }
+
+    while (fanningVertex >= 0)
+    {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (auto adjacencyIndex = adjacencyOffsets[fanningVertex]; adjacencyIndex < adjacencyOffsets[fanningVertex + 1]; adjacencyIndex++)
+        {
+            auto triangle = adjacency[adjacencyIndex];
+            if (isTriangleEmitted[triangle])
+            {
+                continue;
+            }
+
+            for (size_t corner = 0; corner < 3; corner++)
+            {
+                auto vertex = indices[triangle * 3 + corner];
+                optimizedIndices.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangleCounts[vertex]--;
+
+                if (timestamp - cacheTimestamps[vertex] > cacheSize)
+                {
+                    cacheTimestamps[vertex] = timestamp++;
+                }
+            }
+
+            isTriangleEmitted[triangle] = true;
+        }
+
+        // Continue with the candidate which has been in the cache the longest,
+        // as long as it stays cached while its remaining triangles are emitted
+        int64_t nextVertex = -1;
+        int64_t bestPriority = -1;
+        for (auto vertex : candidates)
+        {
+            if (liveTriangleCounts[vertex] == 0)
+            {
+                continue;
+            }
+
+            int64_t priority = 0;
+            if (timestamp - cacheTimestamps[vertex] + 2 * liveTriangleCounts[vertex] <= cacheSize)
+            {
+                priority = timestamp - cacheTimestamps[vertex];
+            }
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                nextVertex = vertex;
+            }
+        }
+
+        if (nextVertex < 0)
+        {
+            nextVertex = skipDeadEnd();
+            if (nextVertex >= 0)
+            {
+                clusters.push_back(static_cast<uint32_t>(optimizedIndices.size() / 3));
+            }
+        }
+
+        fanningVertex = nextVertex;
+    }
+
+    std::copy(optimizedIndices.begin(), optimizedIndices.end(), indices.begin());
+
+    return clusters;
+}
+
+void OptimizeOverdraw(
+    std::span<uint32_t> indices,
+    std::span<const VertexPositionNormalUv> vertices,
+    std::span<const uint32_t> clusters)
+{
+    if (clusters.size() < 2)
+    {
+        return;
+    }
+
+    auto triangleCount = indices.size() / 3;
+    auto getClusterEnd = [&](size_t cluster)
+    {
+        return cluster + 1 < clusters.size() ? clusters[cluster + 1] : triangleCount;
+    };
+
+    struct ClusterInfo
+    {
+        glm::vec3 weightedCentroid = glm::vec3(0.0f);
+        glm::vec3 normal = glm::vec3(0.0f);
+        float area = 0.0f;
+        float score = 0.0f;
+    };
+    std::vector<ClusterInfo> clusterInfos(clusters.size());
+
+    auto meshWeightedCentroid = glm::vec3(0.0f);
+    auto meshArea = 0.0f;
+    for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+    {
+        auto& clusterInfo = clusterInfos[cluster];
+        for (auto triangle = clusters[cluster]; triangle < getClusterEnd(cluster); triangle++)
+        {
+            auto& p0 = vertices[indices[triangle * 3 + 0]].position;
+            auto& p1 = vertices[indices[triangle * 3 + 1]].position;
+            auto& p2 = vertices[indices[triangle * 3 + 2]].position;
+
+            auto weightedNormal = glm::cross(p1 - p0, p2 - p0);
+            auto area = glm::length(weightedNormal) * 0.5f;
+
+            clusterInfo.weightedCentroid += (p0 + p1 + p2) * (area / 3.0f);
+            clusterInfo.normal += weightedNormal;
+            clusterInfo.area += area;
+        }
+
+        meshWeightedCentroid += clusterInfo.weightedCentroid;
+        meshArea += clusterInfo.area;
+    }
+
+    if (meshArea <= 0.0f)
+    {
+        return;
+    }
+
+    auto meshCentroid = meshWeightedCentroid / meshArea;
+    for (auto& clusterInfo : clusterInfos)
+    {
+        auto normalLength = glm::length(clusterInfo.normal);
+        if (clusterInfo.area > 0.0f && normalLength > 0.0f)
+        {
+            clusterInfo.score = glm::dot(clusterInfo.weightedCentroid / clusterInfo.area - meshCentroid, clusterInfo.normal / normalLength);
+        }
+    }
+
+    std::vector<uint32_t> clusterOrder(clusters.size());
+    for (size_t cluster = 0; cluster < clusters.size(); cluster++)
+    {
+        clusterOrder[cluster] = static_cast<uint32_t>(cluster);
+    }
+
+    std::stable_sort(clusterOrder.begin(), clusterOrder.end(), [&](uint32_t left, uint32_t right)
+    {
+        return clusterInfos[left].score > clusterInfos[right].score;
+    });
+
+    std::vector<uint32_t> sortedIndices;
+    sortedIndices.reserve(indices.size());
+    for (auto cluster : clusterOrder)
+    {
+        sortedIndices.insert(sortedIndices.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + getClusterEnd(cluster) * 3);
+    }
+
+    std::copy(sortedIndices.begin(), sortedIndices.end(), indices.begin());
+}
+
+std::vector<uint32_t> OptimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount)
+{
+    constexpr auto unassigned = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> oldToNew(vertexCount, unassigned);
+    std::vector<uint32_t> vertexRemap;
+    vertexRemap.reserve(vertexCount);
+
+    for (auto& index : indices)
+    {
+        if (oldToNew[index] == unassigned)
+        {
+            oldToNew[index] = static_cast<uint32_t>(vertexRemap.size());
+            vertexRemap.push_back(index);
+        }
+
+        index = oldToNew[index];
+    }
+
+    for (size_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        if (oldToNew[vertex] == unassigned)
+        {
+            vertexRemap.push_back(static_cast<uint32_t>(vertex));
+        }
+    }
+
+    return vertexRemap;
+}
+
+size_t SimulateVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+    std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+
+    size_t transformedVertexCount = 0;
+    for (auto index : indices)
+    {
+        if (timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            transformedVertexCount++;
+        }
+    }
+
+    return transformedVertexCount;
+}
+
+OptimizedGeometry OptimizeGeometry(std::span<const VertexPositionNormalUv> vertices, std::span<const uint32_t> indices)
+{
+    OptimizedGeometry optimizedGeometry;
+    optimizedGeometry.indices.assign(indices.begin(), indices.end());
+
+    // Malformed glTF, the indices are uploaded as they are and nothing here reads out of bounds
+    auto isIndexOutOfRange = [&](uint32_t index)
+    {
+        return index >= vertices.size();
+    };
+    if (std::any_of(indices.begin(), indices.end(), isIndexOutOfRange))
+    {
+        optimizedGeometry.vertexRemap.resize(vertices.size());
+        for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+        {
+            optimizedGeometry.vertexRemap[vertex] = static_cast<uint32_t>(vertex);
+        }
+
+        optimizedGeometry.transformedVertexCountBefore = indices.size();
+        optimizedGeometry.transformedVertexCountAfter = indices.size();
+        return optimizedGeometry;
+    }
+
+    optimizedGeometry.transformedVertexCountBefore = SimulateVertexCache(indices, vertices.size(), VERTEX_CACHE_SIZE);
+
+    auto clusters = OptimizeVertexCache(optimizedGeometry.indices, vertices.size(), VERTEX_CACHE_SIZE);
+    OptimizeOverdraw(optimizedGeometry.indices, vertices, clusters);
+    optimizedGeometry.transformedVertexCountAfter = SimulateVertexCache(optimizedGeometry.indices, vertices.size(), VERTEX_CACHE_SIZE);
+
+    // Renumbering vertices does not change which are cached, only where they are fetched from
+    optimizedGeometry.vertexRemap = OptimizeVertexFetch(optimizedGeometry.indices, vertices.size());
+
+    return optimizedGeometry;
+}
+
+std::shared_ptr<const OptimizedGeometry> GeometryOptimizationCache::GetOrOptimize(
+    const std::string& key,
+    std::span<const VertexPositionNormalUv> vertices,
+    std::span<const uint32_t> indices)
+{
+    std::shared_ptr<Entry> entry;
+    {
+        std::lock_guard lock(_mutex);
+        auto& cachedEntry = _entries[key];
+        if (cachedEntry == nullptr)
+        {
+            cachedEntry = std::make_shared<Entry>();
+        }
+
+        entry = cachedEntry;
+    }
+
+    std::call_once(entry->optimizeOnce, [&]()
+    {
+        entry->geometry = OptimizeGeometry(vertices, indices);
+    });
+
+    return std::shared_ptr<const OptimizedGeometry>(entry, &entry->geometry);
+}
+
+void GeometryOptimizationCache::Clear()
+{
+    std::lock_guard lock(_mutex);
+    _entries.clear();
+}
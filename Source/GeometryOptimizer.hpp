@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Mesh.hpp"
+
+// Size of the FIFO post-transform cache the optimizer targets and the statistics simulate
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct OptimizedGeometry
+{
+    // Optimized vertex i is decoded vertex vertexRemap[i]
+    std::vector<uint32_t> vertexRemap;
+    std::vector<uint32_t> indices;
+
+    size_t transformedVertexCountBefore = 0;
+    size_t transformedVertexCountAfter = 0;
+};
+
+// Tipsify (Sander et al. 2007), reorders triangles for the post-transform cache. Returns the first
+// triangle of every cluster, a cluster ends wherever the walk had to jump to a dead end
+std::vector<uint32_t> OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize);
+
+// Reorders the clusters OptimizeVertexCache found, those facing away from the mesh's center first,
+// so they tend to occlude the rest. Triangle order within a cluster is kept
+void OptimizeOverdraw(
+    std::span<uint32_t> indices,
+    std::span<const VertexPositionNormalUv> vertices,
+    std::span<const uint32_t> clusters);
+
+// Renumbers vertices in order of first use and rewrites indices accordingly, unused vertices go last.
+// Returns the new to old vertex mapping
+std::vector<uint32_t> OptimizeVertexFetch(std::span<uint32_t> indices, size_t vertexCount);
+
+// How many vertex shader invocations a FIFO cache of cacheSize entries needs for the indices
+size_t SimulateVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize);
+
+// The functions above index per vertex arrays with the indices as they are. Primitives referencing
+// vertices past the end come back unoptimized, every index counted as transformed
+OptimizedGeometry OptimizeGeometry(std::span<const VertexPositionNormalUv> vertices, std::span<const uint32_t> indices);
+
+// Optimization results by asset and primitive, so a primitive referenced by several nodes or loaded
+// again is optimized once. Safe to use from several jobs at once
+class GeometryOptimizationCache
+{
+public:
+    // Concurrent callers with the same key wait for the first one's result
+    std::shared_ptr<const OptimizedGeometry> GetOrOptimize(
+        const std::string& key,
+        std::span<const VertexPositionNormalUv> vertices,
+        std::span<const uint32_t> indices);
+
+    void Clear();
+
+private:
+    struct Entry
+    {
+        std::once_flag optimizeOnce;
+        OptimizedGeometry geometry;
+    };
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<Entry>> _entries;
+};
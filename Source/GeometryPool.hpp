@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <format>
+#include <string>
+
+#include "Types.hpp"
+
+struct GeometryRange
+{
+    int32_t vertexOffset = 0;
+    // In units of the range's index type
+    uint32_t firstIndex = 0;
+    VkDeviceSize indexByteOffset = 0;
+    // Rounded up to 4 bytes, which keeps every range of either index type aligned
+    VkDeviceSize indexByteSize = 0;
+};
+
+inline uint32_t GetIndexSize(VkIndexType indexType)
+{
+    return indexType == VkIndexType::VK_INDEX_TYPE_UINT16
+        ? sizeof(uint16_t)
+        : sizeof(uint32_t);
+}
+
+// One vertex and one index buffer shared by all meshes, so a frame binds geometry once.
+// 16 and 32 bit indices share the index buffer, it is bound once per index type.
+// Meshes live until shutdown, allocations only ever bump the end of the pool
+class GeometryPool
+{
+public:
+    void Initialize(
+        const AllocatedBuffer& vertexBuffer,
+        uint32_t vertexStride,
+        const AllocatedBuffer& indexBuffer)
+    {
+        _vertexBuffer = vertexBuffer;
+        _vertexStride = vertexStride;
+        _vertexCapacity = static_cast<uint32_t>(vertexBuffer.bufferSize / vertexStride);
+        _indexBuffer = indexBuffer;
+    }
+
+    std::expected<GeometryRange, std::string> Allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType)
+    {
+        auto indexByteSize = (static_cast<VkDeviceSize>(indexCount) * GetIndexSize(indexType) + 3) & ~VkDeviceSize(3);
+
+        if (_vertexCount + vertexCount > _vertexCapacity)
+        {
+            return std::unexpected(std::format("GeometryPool: Out of vertex space, {} of {} vertices in use", _vertexCount, _vertexCapacity));
+        }
+
+        if (_indexByteCount + indexByteSize > _indexBuffer.bufferSize)
+        {
+            return std::unexpected(std::format("GeometryPool: Out of index space, {} of {} bytes in use", _indexByteCount, _indexBuffer.bufferSize));
+        }
+
+        GeometryRange geometryRange =
+        {
+            .vertexOffset = static_cast<int32_t>(_vertexCount),
+            .firstIndex = static_cast<uint32_t>(_indexByteCount / GetIndexSize(indexType)),
+            .indexByteOffset = _indexByteCount,
+            .indexByteSize = indexByteSize
+        };
+
+        _vertexCount += vertexCount;
+        _indexByteCount += indexByteSize;
+
+        return geometryRange;
+    }
+
+    // Gives back everything allocated since the pool was at these counts, only valid while nobody else
+    // allocated in between
+    void Rewind(uint32_t vertexCount, VkDeviceSize indexByteCount)
+    {
+        _vertexCount = vertexCount;
+        _indexByteCount = indexByteCount;
+    }
+
+    const AllocatedBuffer& GetVertexBuffer() const { return _vertexBuffer; }
+    const AllocatedBuffer& GetIndexBuffer() const { return _indexBuffer; }
+    uint32_t GetVertexStride() const { return _vertexStride; }
+    uint32_t GetVertexCount() const { return _vertexCount; }
+    VkDeviceSize GetIndexByteCount() const { return _indexByteCount; }
+
+private:
+    AllocatedBuffer _vertexBuffer = {};
+    uint32_t _vertexStride = 0;
+    uint32_t _vertexCapacity = 0;
+    uint32_t _vertexCount = 0;
+
+    AllocatedBuffer _indexBuffer = {};
+    VkDeviceSize _indexByteCount = 0;
+};
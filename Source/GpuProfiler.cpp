@@ -0,0 +1,113 @@
+#include "GpuProfiler.hpp"
+
+bool GpuProfiler::Initialize(
+    [[maybe_unused]] VkPhysicalDevice physicalDevice,
+    VkDevice device,
+    [[maybe_unused]] VkQueue queue,
+    [[maybe_unused]] VkCommandBuffer calibrationCommandBuffer,
+    float timestampPeriod,
+    uint32_t timestampValidBits)
+{
+    _device = device;
+    _timestampPeriod = timestampPeriod;
+    _timestampMask = timestampValidBits < 64 ? (1ull << timestampValidBits) - 1 : ~0ull;
+    _timings.reserve(MAX_GPU_PROFILER_QUERIES / 2);
+    _timestamps.resize(MAX_GPU_PROFILER_QUERIES);
+
+    _tracyContext = TracyVkContext(physicalDevice, device, queue, calibrationCommandBuffer);
+
+    return true;
+}
+
+void GpuProfiler::Destroy()
+{
+    TracyVkDestroy(_tracyContext);
+    _tracyContext = {};
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer commandBuffer, GpuTimestampQueries& timestampQueries)
+{
+    _currentQueries = nullptr;
+    _currentDepth = 0;
+
+    if (timestampQueries.queryPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    if (timestampQueries.queryCount > 0 && vkGetQueryPoolResults(
+        _device,
+        timestampQueries.queryPool,
+        0,
+        timestampQueries.queryCount,
+        timestampQueries.queryCount * sizeof(uint64_t),
+        _timestamps.data(),
+        sizeof(uint64_t),
+        VkQueryResultFlagBits::VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+    {
+        _timings.clear();
+        for (auto& scope : timestampQueries.scopes)
+        {
+            auto elapsedTicks = static_cast<double>((_timestamps[scope.endQuery] - _timestamps[scope.beginQuery]) & _timestampMask);
+            _timings.push_back(GpuScopeTiming
+            {
+                .name = scope.name,
+                .depth = scope.depth,
+                .milliseconds = elapsedTicks * _timestampPeriod / 1000000.0
+            });
+        }
+    }
+
+    vkCmdResetQueryPool(commandBuffer, timestampQueries.queryPool, 0, MAX_GPU_PROFILER_QUERIES);
+    timestampQueries.queryCount = 0;
+    timestampQueries.scopes.clear();
+
+    _currentQueries = &timestampQueries;
+}
+
+void GpuProfiler::EndFrame([[maybe_unused]] VkCommandBuffer commandBuffer)
+{
+    TracyVkCollect(_tracyContext, commandBuffer);
+    _currentQueries = nullptr;
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer commandBuffer, std::string_view name)
+{
+    if (_currentQueries == nullptr || _currentQueries->queryCount + 2 > MAX_GPU_PROFILER_QUERIES)
+    {
+        return UINT32_MAX;
+    }
+
+    auto scopeIndex = static_cast<uint32_t>(_currentQueries->scopes.size());
+    auto& scope = _currentQueries->scopes.emplace_back();
+    scope.name = name;
+    scope.depth = _currentDepth++;
+    scope.beginQuery = _currentQueries->queryCount++;
+    // reserved now so nested scopes cannot take it
+    scope.endQuery = _currentQueries->queryCount++;
+
+    vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, _currentQueries->queryPool, scope.beginQuery);
+
+    return scopeIndex;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer commandBuffer, uint32_t scopeIndex)
+{
+    if (_currentQueries == nullptr || scopeIndex == UINT32_MAX)
+    {
+        return;
+    }
+
+    _currentDepth--;
+    vkCmdWriteTimestamp(commandBuffer, VkPipelineStageFlagBits::VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, _currentQueries->queryPool, _currentQueries->scopes[scopeIndex].endQuery);
+}
+
+std::span<const GpuScopeTiming> GpuProfiler::GetTimings() const
+{
+    return _timings;
+}
+
+TracyVkCtx GpuProfiler::GetTracyContext() const
+{
+    return _tracyContext;
+}
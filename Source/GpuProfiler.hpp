@@ -0,0 +1,98 @@
+#pragma once
+
+#include <volk.h>
+#include <tracy/TracyVulkan.hpp>
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+constexpr uint32_t MAX_GPU_PROFILER_QUERIES = 128;
+
+struct GpuScope
+{
+    std::string_view name;
+    uint32_t depth = 0;
+    uint32_t beginQuery = 0;
+    uint32_t endQuery = 0;
+};
+
+struct GpuScopeTiming
+{
+    std::string_view name;
+    uint32_t depth = 0;
+    double milliseconds = 0.0;
+};
+
+// One per frame in flight, so reading results never waits on a frame still in flight
+struct GpuTimestampQueries
+{
+    VkQueryPool queryPool = {};
+    uint32_t queryCount = 0;
+    std::vector<GpuScope> scopes;
+};
+
+class GpuProfiler
+{
+public:
+    bool Initialize(
+        VkPhysicalDevice physicalDevice,
+        VkDevice device,
+        VkQueue queue,
+        VkCommandBuffer calibrationCommandBuffer,
+        float timestampPeriod,
+        uint32_t timestampValidBits);
+    void Destroy();
+
+    // Resolves what was recorded the last time these queries were used, the frame's fence must have signaled
+    void BeginFrame(VkCommandBuffer commandBuffer, GpuTimestampQueries& timestampQueries);
+    void EndFrame(VkCommandBuffer commandBuffer);
+
+    uint32_t BeginScope(VkCommandBuffer commandBuffer, std::string_view name);
+    void EndScope(VkCommandBuffer commandBuffer, uint32_t scopeIndex);
+
+    std::span<const GpuScopeTiming> GetTimings() const;
+    TracyVkCtx GetTracyContext() const;
+
+private:
+    VkDevice _device = {};
+    float _timestampPeriod = 1.0f;
+    // Timestamps wrap around after timestampValidBits, the bits above are undefined
+    uint64_t _timestampMask = ~0ull;
+    TracyVkCtx _tracyContext = {};
+
+    GpuTimestampQueries* _currentQueries = nullptr;
+    uint32_t _currentDepth = 0;
+    std::vector<GpuScopeTiming> _timings;
+    std::vector<uint64_t> _timestamps;
+};
+
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, std::string_view name)
+        : _profiler(profiler),
+          _commandBuffer(commandBuffer),
+          _scopeIndex(profiler.BeginScope(commandBuffer, name))
+    {
+    }
+
+    ~GpuProfileScope()
+    {
+        _profiler.EndScope(_commandBuffer, _scopeIndex);
+    }
+
+private:
+    GpuProfiler& _profiler;
+    VkCommandBuffer _commandBuffer;
+    uint32_t _scopeIndex;
+};
+
+#define GPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define GPU_PROFILE_CONCAT(a, b) GPU_PROFILE_CONCAT_INNER(a, b)
+
+// Tracy wants a string literal for its zone name, so name has to be one as well
+#define GPU_PROFILE_SCOPE(profiler, commandBuffer, name) \
+    TracyVkZone((profiler).GetTracyContext(), commandBuffer, name); \
+    GpuProfileScope GPU_PROFILE_CONCAT(gpuProfileScope, __LINE__)((profiler), (commandBuffer), name)
@@ -0,0 +1,180 @@
+#include "Io.hpp"
+
+#include <format>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    size_t GetPageSize()
+    {
+#if defined(_WIN32)
+        SYSTEM_INFO systemInfo = {};
+        GetSystemInfo(&systemInfo);
+        return systemInfo.dwPageSize;
+#else
+        return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+}
+
+uint64_t HashBytes(std::span<const std::byte> bytes, uint64_t hash)
+{
+    for (auto byte : bytes)
+    {
+        hash ^= static_cast<uint64_t>(byte);
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+std::expected<MappedFile, std::string> MappedFile::Open(const std::filesystem::path& filePath)
+{
+    MappedFile mappedFile;
+
+#if defined(_WIN32)
+    auto file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return std::unexpected(std::format("Io: Unable to open {}", filePath.string()));
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return std::unexpected(std::format("Io: Unable to get the size of {}", filePath.string()));
+    }
+
+    mappedFile._size = static_cast<size_t>(fileSize.QuadPart);
+    if (mappedFile._size > 0)
+    {
+        // The view keeps the mapping and the file alive, both handles can go right away
+        auto fileMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        auto* data = fileMapping != nullptr
+            ? MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0)
+            : nullptr;
+
+        if (fileMapping != nullptr)
+        {
+            CloseHandle(fileMapping);
+        }
+
+        if (data == nullptr)
+        {
+            CloseHandle(file);
+            return std::unexpected(std::format("Io: Unable to map {}", filePath.string()));
+        }
+
+        mappedFile._data = static_cast<const std::byte*>(data);
+    }
+
+    CloseHandle(file);
+#else
+    auto file = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        return std::unexpected(std::format("Io: Unable to open {}", filePath.string()));
+    }
+
+    struct stat fileStatus = {};
+    if (fstat(file, &fileStatus) != 0)
+    {
+        close(file);
+        return std::unexpected(std::format("Io: Unable to get the size of {}", filePath.string()));
+    }
+
+    mappedFile._size = static_cast<size_t>(fileStatus.st_size);
+    if (mappedFile._size > 0)
+    {
+        // The mapping keeps the file alive, the descriptor can go right away
+        auto* data = mmap(nullptr, mappedFile._size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED)
+        {
+            close(file);
+            return std::unexpected(std::format("Io: Unable to map {}", filePath.string()));
+        }
+
+        mappedFile._data = static_cast<const std::byte*>(data);
+    }
+
+    close(file);
+#endif
+
+    auto pageSize = GetPageSize();
+    mappedFile._mappedSize = (mappedFile._size + pageSize - 1) / pageSize * pageSize;
+
+    return mappedFile;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : _data(std::exchange(other._data, nullptr)),
+      _size(std::exchange(other._size, 0)),
+      _mappedSize(std::exchange(other._mappedSize, 0))
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _mappedSize = std::exchange(other._mappedSize, 0);
+    }
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+const std::byte* MappedFile::GetData() const
+{
+    return _data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return _size;
+}
+
+std::span<const std::byte> MappedFile::GetBytes() const
+{
+    return { _data, _size };
+}
+
+size_t MappedFile::GetMappedSize() const
+{
+    return _mappedSize;
+}
+
+void MappedFile::Close()
+{
+    if (_data == nullptr)
+    {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(_data);
+#else
+    munmap(const_cast<std::byte*>(_data), _size);
+#endif
+
+    _data = nullptr;
+    _size = 0;
+    _mappedSize = 0;
+}
@@ -1,26 +1,40 @@
 #pragma once
 
-#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <span>
 #include <string>
-#include <iostream>
-#include <fstream>
 
-template<typename T>
-std::vector<T> ReadFile(const std::string& filePath)
+// FNV-1a, for telling whether cached data is still up to date
+uint64_t HashBytes(std::span<const std::byte> bytes, uint64_t hash = 0xcbf29ce484222325ull);
+
+// Read only memory mapping of a whole file. Nothing is read up front, pages come in from the
+// page cache on first access, so unused parts of large assets never leave the disk
+class MappedFile
 {
-	std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+public:
+    static std::expected<MappedFile, std::string> Open(const std::filesystem::path& filePath);
 
-	if (!file.is_open())
-    {
-		throw std::runtime_error("Failed to open file");
-	}
+    MappedFile() = default;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
 
-	size_t fileSize = (size_t)file.tellg();
-	std::vector<T> buffer(fileSize);
+    // Page aligned, nullptr for empty files
+    const std::byte* GetData() const;
+    size_t GetSize() const;
+    std::span<const std::byte> GetBytes() const;
+    // The mapping covers whole pages, the bytes between GetSize and GetMappedSize read as zero
+    size_t GetMappedSize() const;
 
-	file.seekg(0);
-	file.read((char*)buffer.data(), static_cast<std::streamsize>(fileSize));
-	file.close();
+private:
+    void Close();
 
-	return buffer;
-}
\ No newline at end of file
+    const std::byte* _data{nullptr};
+    size_t _size{0};
+    size_t _mappedSize{0};
+};
@@ -0,0 +1,226 @@
+#include "JobSystem.hpp"
+
+#include <tracy/Tracy.hpp>
+
+#include <algorithm>
+#include <format>
+
+namespace
+{
+    // Queue 0 is shared by every thread which is not a worker
+    thread_local size_t t_queueIndex = 0;
+}
+
+bool JobSystem::Initialize(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        auto hardwareThreadCount = std::thread::hardware_concurrency();
+        workerCount = hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 1;
+    }
+
+    _queues.reserve(workerCount + 1);
+    for (uint32_t queueIndex = 0; queueIndex < workerCount + 1; queueIndex++)
+    {
+        _queues.push_back(std::make_unique<JobQueue>());
+    }
+
+    _isRunning = true;
+
+    _workers.reserve(workerCount);
+    for (uint32_t workerIndex = 0; workerIndex < workerCount; workerIndex++)
+    {
+        _workers.emplace_back([this, workerIndex]()
+        {
+            WorkerLoop(workerIndex + 1);
+        });
+    }
+
+    return true;
+}
+
+void JobSystem::Destroy()
+{
+    {
+        std::lock_guard lock(_wakeMutex);
+        _isRunning = false;
+    }
+    _wakeCondition.notify_all();
+
+    for (auto& worker : _workers)
+    {
+        worker.join();
+    }
+
+    _workers.clear();
+    _queues.clear();
+}
+
+void JobSystem::Schedule(JobCounter& counter, std::function<void()>&& job)
+{
+    counter.pendingJobCount.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        auto& queue = *_queues[t_queueIndex];
+        std::lock_guard lock(queue.mutex);
+        queue.jobs.push_back(Job
+        {
+            .function = std::move(job),
+            .counter = &counter
+        });
+    }
+
+    {
+        std::lock_guard lock(_wakeMutex);
+        _queuedJobCount.fetch_add(1, std::memory_order_release);
+    }
+    _wakeCondition.notify_one();
+}
+
+void JobSystem::ScheduleBackground(JobCounter& counter, std::function<void()>&& job)
+{
+    counter.pendingJobCount.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard lock(_backgroundQueue.mutex);
+        _backgroundQueue.jobs.push_back(Job
+        {
+            .function = std::move(job),
+            .counter = &counter
+        });
+    }
+
+    {
+        std::lock_guard lock(_wakeMutex);
+        _queuedJobCount.fetch_add(1, std::memory_order_release);
+    }
+    _wakeCondition.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    ZoneScoped;
+
+    while (counter.pendingJobCount.load(std::memory_order_acquire) > 0)
+    {
+        Job job;
+        if (TryGetJob(t_queueIndex, false, job))
+        {
+            Execute(job);
+        }
+        else
+        {
+            // The remaining jobs are running on other threads
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t)>& function)
+{
+    ZoneScoped;
+
+    batchSize = std::max<size_t>(batchSize, 1);
+
+    JobCounter counter;
+    for (size_t batchStart = 0; batchStart < count; batchStart += batchSize)
+    {
+        auto batchEnd = std::min(batchStart + batchSize, count);
+        Schedule(counter, [&function, batchStart, batchEnd]()
+        {
+            for (size_t index = batchStart; index < batchEnd; index++)
+            {
+                function(index);
+            }
+        });
+    }
+
+    Wait(counter);
+}
+
+uint32_t JobSystem::GetWorkerCount() const
+{
+    return static_cast<uint32_t>(_workers.size());
+}
+
+void JobSystem::WorkerLoop(size_t queueIndex)
+{
+    t_queueIndex = queueIndex;
+
+    auto threadName = std::format("JobWorker_{}", queueIndex);
+    tracy::SetThreadName(threadName.c_str());
+
+    while (true)
+    {
+        Job job;
+        if (TryGetJob(queueIndex, true, job))
+        {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock lock(_wakeMutex);
+        _wakeCondition.wait(lock, [this]()
+        {
+            return !_isRunning || _queuedJobCount.load(std::memory_order_acquire) > 0;
+        });
+
+        if (!_isRunning)
+        {
+            return;
+        }
+    }
+}
+
+bool JobSystem::TryGetJob(size_t queueIndex, bool isBackgroundAllowed, Job& job)
+{
+    // Own queue first, newest job first while it is still warm in cache
+    {
+        auto& queue = *_queues[queueIndex];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+            _queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Steal the oldest job of someone else
+    for (size_t offset = 1; offset < _queues.size(); offset++)
+    {
+        auto& queue = *_queues[(queueIndex + offset) % _queues.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            _queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Background jobs last, everything else is likely waited on by someone
+    if (isBackgroundAllowed)
+    {
+        std::lock_guard lock(_backgroundQueue.mutex);
+        if (!_backgroundQueue.jobs.empty())
+        {
+            job = std::move(_backgroundQueue.jobs.front());
+            _backgroundQueue.jobs.pop_front();
+            _queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::Execute(Job& job)
+{
+    ZoneScopedN("Job");
+
+    job.function();
+    job.counter->pendingJobCount.fetch_sub(1, std::memory_order_release);
+}
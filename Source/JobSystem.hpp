@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the jobs scheduled against it which have not finished yet
+struct JobCounter
+{
+    std::atomic<uint32_t> pendingJobCount{0};
+};
+
+// Every worker owns a queue it pushes to and pops from the back of, idle workers steal from the
+// front of the others. Threads outside the system share one more queue, Wait makes them help out
+// instead of blocking. Background jobs go into a queue of their own which only idle workers take
+// from, so long running work like asset loading never ends up on a thread waiting for something else
+class JobSystem
+{
+public:
+    // workerCount 0 picks one worker per hardware thread, minus the calling thread
+    bool Initialize(uint32_t workerCount = 0);
+    void Destroy();
+
+    void Schedule(JobCounter& counter, std::function<void()>&& job);
+    // Runs in the order scheduled, on workers only
+    void ScheduleBackground(JobCounter& counter, std::function<void()>&& job);
+    void Wait(JobCounter& counter);
+
+    // Calls function for every index in [0, count), batchSize indices per job, and waits for all of them
+    void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t)>& function);
+
+    uint32_t GetWorkerCount() const;
+
+private:
+    struct Job
+    {
+        std::function<void()> function;
+        JobCounter* counter = nullptr;
+    };
+
+    struct JobQueue
+    {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    void WorkerLoop(size_t queueIndex);
+    bool TryGetJob(size_t queueIndex, bool isBackgroundAllowed, Job& job);
+    void Execute(Job& job);
+
+    std::vector<std::unique_ptr<JobQueue>> _queues;
+    JobQueue _backgroundQueue;
+    std::vector<std::thread> _workers;
+
+    std::atomic<bool> _isRunning{false};
+    std::atomic<uint32_t> _queuedJobCount{0};
+    std::mutex _wakeMutex;
+    std::condition_variable _wakeCondition;
+};
@@ -1,8 +1,10 @@
 #include <cstdint>
 #include <cstdlib>
 
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "ApplicationIcon.hpp"
@@ -12,10 +14,54 @@
 
 constexpr int32_t MAX_FRAMES_IN_FLIGHT = 3;
 
-int32_t main([[maybe_unused]] int32_t argc, [[maybe_unused]] char* argv[])
+bool WritePpm(const std::string& filePath, const ReadbackImage& image)
 {
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    file << "P6\n" << image.width << " " << image.height << "\n255\n";
+    for (size_t pixelIndex = 0; pixelIndex < static_cast<size_t>(image.width) * image.height; pixelIndex++)
+    {
+        // offscreen images are RGBA8, PPM wants RGB
+        file.write(reinterpret_cast<const char*>(&image.pixels[pixelIndex * 4]), 3);
+    }
+
+    return file.good();
+}
+
+int32_t main(int32_t argc, char* argv[])
+{
+    EngineOptions engineOptions;
+    uint32_t headlessFrameCount = 1;
+    std::string outputFilePath;
+
+    for (int32_t argumentIndex = 1; argumentIndex < argc; argumentIndex++)
+    {
+        std::string_view argument = argv[argumentIndex];
+        if (argument == "--headless")
+        {
+            engineOptions.headless = true;
+        }
+        else if (argument == "--frames" && argumentIndex + 1 < argc)
+        {
+            headlessFrameCount = static_cast<uint32_t>(std::strtoul(argv[++argumentIndex], nullptr, 10));
+        }
+        else if (argument == "--output" && argumentIndex + 1 < argc)
+        {
+            outputFilePath = argv[++argumentIndex];
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--headless] [--frames <count>] [--output <file.ppm>]\n";
+            return EXIT_FAILURE;
+        }
+    }
+
     Engine engine;
-    if (!engine.Initialize())
+    if (!engine.Initialize(engineOptions))
     {
         return EXIT_FAILURE;
     }
@@ -26,6 +72,42 @@ int32_t main([[maybe_unused]] int32_t argc, [[maybe_unused]] char* argv[])
         return EXIT_FAILURE;
     }
 
+    if (engine.IsHeadless())
+    {
+        // so the captured frames show the whole scene
+        engine.WaitForPendingUploads();
+
+        for (uint32_t frame = 0; frame < headlessFrameCount; frame++)
+        {
+            if (!engine.Draw())
+            {
+                engine.Unload();
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (!outputFilePath.empty())
+        {
+            auto readbackResult = engine.ReadbackFrame();
+            if (!readbackResult.has_value())
+            {
+                std::cerr << readbackResult.error() << "\n";
+                engine.Unload();
+                return EXIT_FAILURE;
+            }
+
+            if (!WritePpm(outputFilePath, readbackResult.value()))
+            {
+                std::cerr << "Unable to write " << outputFilePath << "\n";
+                engine.Unload();
+                return EXIT_FAILURE;
+            }
+        }
+
+        engine.Unload();
+        return EXIT_SUCCESS;
+    }
+
     //auto currentTime = glfwGetTime();
     //auto previousTime = currentTime;
 
@@ -36,6 +118,13 @@ int32_t main([[maybe_unused]] int32_t argc, [[maybe_unused]] char* argv[])
         //auto deltaTime = static_cast<float>(currentTime - previousTime);
         //previousTime = currentTime;
 
+        // Sleeps until the window is restored instead of spinning on skipped frames
+        if (engine.IsMinimized())
+        {
+            glfwWaitEvents();
+            continue;
+        }
+
         if (!engine.Draw())
         {
             break;
@@ -45,4 +134,4 @@ int32_t main([[maybe_unused]] int32_t argc, [[maybe_unused]] char* argv[])
     engine.Unload();
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -70,4 +70,40 @@ VertexInputDescription VertexPositionNormalUv::GetVertexInputDescription()
     vertexInputDescription.attributes.push_back(uvAttribute);
 
     return vertexInputDescription;
-}
\ No newline at end of file
+}
+
+VertexInputDescription VertexPackedPositionNormalUv::GetVertexInputDescription()
+{
+    VertexInputDescription vertexInputDescription = {};
+
+    VkVertexInputBindingDescription inputBindingDescription = {};
+    inputBindingDescription.binding = 0;
+    inputBindingDescription.stride = sizeof(VertexPackedPositionNormalUv);
+    inputBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    vertexInputDescription.bindings.push_back(inputBindingDescription);
+
+    VkVertexInputAttributeDescription positionAttribute = {};
+    positionAttribute.binding = 0;
+    positionAttribute.location = 0;
+    positionAttribute.format = VK_FORMAT_R16G16B16A16_SNORM;
+    positionAttribute.offset = offsetof(VertexPackedPositionNormalUv, position);
+
+    VkVertexInputAttributeDescription normalAttribute = {};
+    normalAttribute.binding = 0;
+    normalAttribute.location = 1;
+    normalAttribute.format = VK_FORMAT_R16G16_SNORM;
+    normalAttribute.offset = offsetof(VertexPackedPositionNormalUv, normal);
+
+    VkVertexInputAttributeDescription uvAttribute = {};
+    uvAttribute.binding = 0;
+    uvAttribute.location = 2;
+    uvAttribute.format = VK_FORMAT_R16G16_SFLOAT;
+    uvAttribute.offset = offsetof(VertexPackedPositionNormalUv, uv);
+
+    vertexInputDescription.attributes.push_back(positionAttribute);
+    vertexInputDescription.attributes.push_back(normalAttribute);
+    vertexInputDescription.attributes.push_back(uvAttribute);
+
+    return vertexInputDescription;
+}
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <string_view>
+#include <string>
 #include <vector>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -27,13 +27,55 @@ struct VertexPositionNormalUv
     static VertexInputDescription GetVertexInputDescription();
 };
 
+// 16 bytes instead of 32. Positions are snorm16 within the mesh's bounds, the mesh's positionOffset and
+// positionScale turn them back into model space. Normals are octahedral encoded snorm16, uvs half floats
+struct VertexPackedPositionNormalUv
+{
+    int16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+
+    static VertexInputDescription GetVertexInputDescription();
+};
+
+enum class VertexFormat
+{
+    PositionNormalUv,
+    PackedPositionNormalUv
+};
+
+inline uint32_t GetVertexStride(VertexFormat vertexFormat)
+{
+    return vertexFormat == VertexFormat::PackedPositionNormalUv
+        ? sizeof(VertexPackedPositionNormalUv)
+        : sizeof(VertexPositionNormalUv);
+}
+
 struct Mesh
 {
+    // Empty once uploaded, unless the engine was asked to keep CPU geometry around
 	std::vector<VertexPositionNormalUv> vertices;
     std::vector<uint32_t> indices;
-	AllocatedBuffer vertexBuffer;
-    AllocatedBuffer indexBuffer;
+
+    // Format of the GPU copy, the CPU copy is always VertexPositionNormalUv
+    VertexFormat vertexFormat = VertexFormat::PositionNormalUv;
+    uint32_t vertexCount = 0;
+    // Packed positions dequantize to positionOffset + position * positionScale
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    glm::vec3 positionScale = glm::vec3(1.0f);
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    // Where the mesh lives inside the engine's GeometryPool. The CPU copy of the indices is always
+    // 32 bit, the GPU copy is 16 bit whenever the vertex count allows it
+    VkIndexType indexType = VkIndexType::VK_INDEX_TYPE_UINT32;
+    uint32_t indexCount = 0;
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+
+    // Not drawn before the AsyncUploader completed this ticket
+    uint64_t uploadTicket = 0;
 
     glm::mat4 worldMatrix;
-    std::string_view name;
+    std::string name;
 };
\ No newline at end of file
@@ -0,0 +1,411 @@
+#include "MeshCache.hpp"
+#include "GeometryPool.hpp"
+#include "Io.hpp"
+
+#include <fastgltf/types.hpp>
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <regex>
+
+namespace
+{
+    constexpr uint32_t MESH_CACHE_MAGIC = 0x4d4b5546; // FUKM
+    constexpr uint64_t MESH_CACHE_BLOB_ALIGNMENT = 16;
+
+    struct MeshCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t vertexFormat;
+        uint32_t isGeometryOptimized;
+        uint32_t meshCount;
+        uint32_t dependencyCount;
+        uint64_t stringDataSize;
+        uint64_t triangleCount;
+        uint64_t transformedVertexCountBefore;
+        uint64_t transformedVertexCountAfter;
+        uint64_t vertexDataSize;
+        uint64_t indexDataSize;
+    };
+
+    // A file the source references, like a .gltf's .bin buffers. Compared by size and modification time,
+    // hashing them would cost as much as the warm start saves
+    struct MeshCacheDependency
+    {
+        uint32_t pathOffset;
+        uint32_t pathLength;
+        uint64_t fileSize;
+        int64_t lastWriteTime;
+    };
+
+    struct MeshCacheRecord
+    {
+        uint32_t meshNameOffset;
+        uint32_t meshNameLength;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        glm::mat4 worldMatrix;
+        glm::vec3 positionOffset;
+        glm::vec3 positionScale;
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t indexType;
+    };
+
+    uint64_t AlignBlobOffset(uint64_t offset)
+    {
+        return (offset + MESH_CACHE_BLOB_ALIGNMENT - 1) & ~(MESH_CACHE_BLOB_ALIGNMENT - 1);
+    }
+
+    // External files a .gltf points at, found without parsing the whole document. Binary glTF
+    // carries its buffer inline, so its own hash covers it
+    std::vector<std::string> FindReferencedFiles(std::span<const std::byte> source)
+    {
+        std::vector<std::string> referencedFiles;
+        if (source.size() >= 4 && std::memcmp(source.data(), "glTF", 4) == 0)
+        {
+            return referencedFiles;
+        }
+
+        static const std::regex uriPattern(R"regex("uri"\s*:\s*"([^"]+)")regex");
+        std::string_view text(reinterpret_cast<const char*>(source.data()), source.size());
+        for (std::cregex_iterator match(text.data(), text.data() + text.size(), uriPattern), end; match != end; ++match)
+        {
+            auto uri = (*match)[1].str();
+            if (!uri.starts_with("data:"))
+            {
+                referencedFiles.push_back(std::move(uri));
+            }
+        }
+
+        return referencedFiles;
+    }
+
+    bool TryGetFileStamp(const std::filesystem::path& path, uint64_t& fileSize, int64_t& lastWriteTime)
+    {
+        std::error_code errorCode;
+        fileSize = std::filesystem::file_size(path, errorCode);
+        if (errorCode)
+        {
+            return false;
+        }
+
+        lastWriteTime = static_cast<int64_t>(std::filesystem::last_write_time(path, errorCode).time_since_epoch().count());
+        return !errorCode;
+    }
+}
+
+std::filesystem::path GetMeshCachePath(const std::filesystem::path& cacheDirectory, const std::filesystem::path& sourcePath)
+{
+    // The path hash keeps equally named models from different directories apart
+    auto sourcePathString = sourcePath.generic_string();
+    auto sourcePathHash = HashBytes(std::as_bytes(std::span(sourcePathString.data(), sourcePathString.size())));
+    return cacheDirectory / std::format("{}-{:016x}.fukmesh", sourcePath.stem().string(), sourcePathHash);
+}
+
+std::expected<MeshCacheContents, std::string> ReadMeshCache(
+    const std::filesystem::path& cachePath,
+    const std::filesystem::path& sourcePath,
+    VertexFormat vertexFormat,
+    bool isGeometryOptimized)
+{
+    auto cacheFileResult = MappedFile::Open(cachePath);
+    if (!cacheFileResult.has_value())
+    {
+        return std::unexpected(std::format("MeshCache: No cache at {}", cachePath.string()));
+    }
+
+    auto cacheBytes = cacheFileResult.value().GetBytes();
+    size_t readOffset = 0;
+    auto read = [&](void* destination, size_t size)
+    {
+        if (readOffset + size > cacheBytes.size())
+        {
+            return false;
+        }
+
+        std::memcpy(destination, cacheBytes.data() + readOffset, size);
+        readOffset += size;
+        return true;
+    };
+
+    MeshCacheHeader header = {};
+    if (!read(&header, sizeof(header)) ||
+        header.magic != MESH_CACHE_MAGIC ||
+        header.version != MESH_CACHE_VERSION)
+    {
+        return std::unexpected(std::format("MeshCache: {} was cooked by another version", cachePath.string()));
+    }
+
+    if (header.vertexFormat != static_cast<uint32_t>(vertexFormat) ||
+        header.isGeometryOptimized != static_cast<uint32_t>(isGeometryOptimized))
+    {
+        return std::unexpected(std::format("MeshCache: {} was cooked with other options", cachePath.string()));
+    }
+
+    // Counts and sizes come from disk, a corrupt file must fail here and not in an allocation or a substr
+    auto tableSize =
+        static_cast<uint64_t>(header.dependencyCount) * sizeof(MeshCacheDependency) +
+        static_cast<uint64_t>(header.meshCount) * sizeof(MeshCacheRecord);
+    if (header.stringDataSize > cacheBytes.size() ||
+        tableSize + header.stringDataSize > cacheBytes.size() - readOffset)
+    {
+        return std::unexpected(std::format("MeshCache: {} is truncated", cachePath.string()));
+    }
+
+    std::vector<MeshCacheDependency> dependencies(header.dependencyCount);
+    std::vector<MeshCacheRecord> records(header.meshCount);
+    std::string strings(header.stringDataSize, '\0');
+    if (!read(dependencies.data(), dependencies.size() * sizeof(MeshCacheDependency)) ||
+        !read(records.data(), records.size() * sizeof(MeshCacheRecord)) ||
+        !read(strings.data(), strings.size()))
+    {
+        return std::unexpected(std::format("MeshCache: {} is truncated", cachePath.string()));
+    }
+
+    auto isStringInRange = [&](uint32_t offset, uint32_t length)
+    {
+        return static_cast<uint64_t>(offset) + length <= strings.size();
+    };
+
+    auto vertexStride = GetVertexStride(vertexFormat);
+    uint64_t vertexDataSize = 0;
+    uint64_t indexDataSize = 0;
+    for (auto& record : records)
+    {
+        if (!isStringInRange(record.meshNameOffset, record.meshNameLength) ||
+            !isStringInRange(record.nameOffset, record.nameLength) ||
+            (record.indexType != static_cast<uint32_t>(VkIndexType::VK_INDEX_TYPE_UINT16) &&
+             record.indexType != static_cast<uint32_t>(VkIndexType::VK_INDEX_TYPE_UINT32)))
+        {
+            return std::unexpected(std::format("MeshCache: {} is corrupt", cachePath.string()));
+        }
+
+        vertexDataSize += static_cast<uint64_t>(record.vertexCount) * vertexStride;
+        indexDataSize += (static_cast<uint64_t>(record.indexCount) * GetIndexSize(static_cast<VkIndexType>(record.indexType)) + 3) & ~uint64_t(3);
+    }
+
+    for (auto& dependency : dependencies)
+    {
+        if (!isStringInRange(dependency.pathOffset, dependency.pathLength))
+        {
+            return std::unexpected(std::format("MeshCache: {} is corrupt", cachePath.string()));
+        }
+    }
+
+    // The blobs have to be exactly what the records allocate from the GeometryPool, and inside the file
+    auto vertexDataFileOffset = AlignBlobOffset(readOffset);
+    auto indexDataFileOffset = AlignBlobOffset(vertexDataFileOffset + vertexDataSize);
+    if (vertexDataSize != header.vertexDataSize ||
+        indexDataSize != header.indexDataSize ||
+        indexDataFileOffset + indexDataSize > cacheBytes.size())
+    {
+        return std::unexpected(std::format("MeshCache: {} is corrupt", cachePath.string()));
+    }
+
+    auto sourceResult = MappedFile::Open(sourcePath);
+    if (!sourceResult.has_value())
+    {
+        return std::unexpected(sourceResult.error());
+    }
+
+    if (HashBytes(sourceResult.value().GetBytes()) != header.sourceHash)
+    {
+        return std::unexpected(std::format("MeshCache: {} changed since it was cooked", sourcePath.string()));
+    }
+
+    for (auto& dependency : dependencies)
+    {
+        auto dependencyPath = sourcePath.parent_path() / strings.substr(dependency.pathOffset, dependency.pathLength);
+        uint64_t fileSize = 0;
+        int64_t lastWriteTime = 0;
+        if (!TryGetFileStamp(dependencyPath, fileSize, lastWriteTime) ||
+            fileSize != dependency.fileSize ||
+            lastWriteTime != dependency.lastWriteTime)
+        {
+            return std::unexpected(std::format("MeshCache: {} changed since it was cooked", dependencyPath.string()));
+        }
+    }
+
+    MeshCacheContents contents;
+    contents.meshes.reserve(records.size());
+    for (auto& record : records)
+    {
+        auto& [meshName, mesh] = contents.meshes.emplace_back();
+        meshName = strings.substr(record.meshNameOffset, record.meshNameLength);
+        mesh.name = strings.substr(record.nameOffset, record.nameLength);
+        mesh.worldMatrix = record.worldMatrix;
+        mesh.vertexFormat = vertexFormat;
+        mesh.vertexCount = record.vertexCount;
+        mesh.positionOffset = record.positionOffset;
+        mesh.positionScale = record.positionScale;
+        mesh.boundsMin = record.boundsMin;
+        mesh.boundsMax = record.boundsMax;
+        mesh.indexType = static_cast<VkIndexType>(record.indexType);
+        mesh.indexCount = record.indexCount;
+    }
+
+    contents.triangleCount = header.triangleCount;
+    contents.transformedVertexCountBefore = header.transformedVertexCountBefore;
+    contents.transformedVertexCountAfter = header.transformedVertexCountAfter;
+    contents.vertexDataSize = header.vertexDataSize;
+    contents.indexDataSize = header.indexDataSize;
+    contents.vertexDataFileOffset = vertexDataFileOffset;
+    contents.indexDataFileOffset = indexDataFileOffset;
+
+    return contents;
+}
+
+std::expected<void, std::string> ReadMeshCacheData(
+    const std::filesystem::path& cachePath,
+    const MeshCacheContents& contents,
+    void* vertexData,
+    void* indexData)
+{
+    auto cacheFileResult = MappedFile::Open(cachePath);
+    if (!cacheFileResult.has_value())
+    {
+        return std::unexpected(cacheFileResult.error());
+    }
+
+    auto& cacheFile = cacheFileResult.value();
+    if (contents.vertexDataFileOffset + contents.vertexDataSize > cacheFile.GetSize() ||
+        contents.indexDataFileOffset + contents.indexDataSize > cacheFile.GetSize())
+    {
+        return std::unexpected(std::format("MeshCache: {} is truncated", cachePath.string()));
+    }
+
+    // The only copy the blobs see on a warm start, from the page cache into staging
+    std::memcpy(vertexData, cacheFile.GetData() + contents.vertexDataFileOffset, contents.vertexDataSize);
+    std::memcpy(indexData, cacheFile.GetData() + contents.indexDataFileOffset, contents.indexDataSize);
+
+    return {};
+}
+
+std::expected<void, std::string> WriteMeshCache(
+    const std::filesystem::path& cachePath,
+    const std::filesystem::path& sourcePath,
+    VertexFormat vertexFormat,
+    bool isGeometryOptimized,
+    const MeshCacheContents& contents,
+    std::span<const std::byte> vertexData,
+    std::span<const std::byte> indexData)
+{
+    auto sourceResult = MappedFile::Open(sourcePath);
+    if (!sourceResult.has_value())
+    {
+        return std::unexpected(sourceResult.error());
+    }
+
+    std::string strings;
+    auto addString = [&](const std::string& string, uint32_t& offset, uint32_t& length)
+    {
+        offset = static_cast<uint32_t>(strings.size());
+        length = static_cast<uint32_t>(string.size());
+        strings += string;
+    };
+
+    std::vector<MeshCacheDependency> dependencies;
+    for (auto& referencedFile : FindReferencedFiles(sourceResult.value().GetBytes()))
+    {
+        // Resolved like the loader maps them, percent encoding included
+        fastgltf::URI uri(referencedFile);
+        if (!uri.isLocalPath())
+        {
+            continue;
+        }
+
+        // A dependency the cache can not watch would let stale geometry load on the next warm start
+        auto dependencyPath = uri.fspath().generic_string();
+        MeshCacheDependency dependency = {};
+        if (!TryGetFileStamp(sourcePath.parent_path() / dependencyPath, dependency.fileSize, dependency.lastWriteTime))
+        {
+            return std::unexpected(std::format("MeshCache: Unable to stamp {}, {} is not cached", dependencyPath, sourcePath.string()));
+        }
+
+        addString(dependencyPath, dependency.pathOffset, dependency.pathLength);
+        dependencies.push_back(dependency);
+    }
+
+    std::vector<MeshCacheRecord> records;
+    records.reserve(contents.meshes.size());
+    for (auto& [meshName, mesh] : contents.meshes)
+    {
+        MeshCacheRecord record = {};
+        addString(meshName, record.meshNameOffset, record.meshNameLength);
+        addString(mesh.name, record.nameOffset, record.nameLength);
+        record.worldMatrix = mesh.worldMatrix;
+        record.positionOffset = mesh.positionOffset;
+        record.positionScale = mesh.positionScale;
+        record.boundsMin = mesh.boundsMin;
+        record.boundsMax = mesh.boundsMax;
+        record.vertexCount = mesh.vertexCount;
+        record.indexCount = mesh.indexCount;
+        record.indexType = static_cast<uint32_t>(mesh.indexType);
+        records.push_back(record);
+    }
+
+    MeshCacheHeader header =
+    {
+        .magic = MESH_CACHE_MAGIC,
+        .version = MESH_CACHE_VERSION,
+        .sourceHash = HashBytes(sourceResult.value().GetBytes()),
+        .vertexFormat = static_cast<uint32_t>(vertexFormat),
+        .isGeometryOptimized = static_cast<uint32_t>(isGeometryOptimized),
+        .meshCount = static_cast<uint32_t>(records.size()),
+        .dependencyCount = static_cast<uint32_t>(dependencies.size()),
+        .stringDataSize = strings.size(),
+        .triangleCount = contents.triangleCount,
+        .transformedVertexCountBefore = contents.transformedVertexCountBefore,
+        .transformedVertexCountAfter = contents.transformedVertexCountAfter,
+        .vertexDataSize = vertexData.size(),
+        .indexDataSize = indexData.size()
+    };
+
+    std::error_code errorCode;
+    std::filesystem::create_directories(cachePath.parent_path(), errorCode);
+
+    // Written next to the cache and renamed over it, so a cache file is either complete or missing
+    auto temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            return std::unexpected(std::format("MeshCache: Unable to create {}", temporaryPath.string()));
+        }
+
+        const char padding[MESH_CACHE_BLOB_ALIGNMENT] = {};
+        auto writePadding = [&]()
+        {
+            auto offset = static_cast<uint64_t>(file.tellp());
+            file.write(padding, static_cast<std::streamsize>(AlignBlobOffset(offset) - offset));
+        };
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(dependencies.data()), static_cast<std::streamsize>(dependencies.size() * sizeof(MeshCacheDependency)));
+        file.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(MeshCacheRecord)));
+        file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+        writePadding();
+        file.write(reinterpret_cast<const char*>(vertexData.data()), static_cast<std::streamsize>(vertexData.size()));
+        writePadding();
+        file.write(reinterpret_cast<const char*>(indexData.data()), static_cast<std::streamsize>(indexData.size()));
+        if (!file)
+        {
+            return std::unexpected(std::format("MeshCache: Unable to write {}", temporaryPath.string()));
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, cachePath, errorCode);
+    if (errorCode)
+    {
+        return std::unexpected(std::format("MeshCache: Unable to replace {}: {}", cachePath.string(), errorCode.message()));
+    }
+
+    return {};
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Mesh.hpp"
+
+// Bump whenever decoding, packing or optimizing produces different bytes, older caches are recooked then
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+
+// What a model cooks down to: its meshes without CPU geometry, in geometry pool allocation order,
+// and the GPU ready vertex and index data of all of them. Index data of every mesh is padded to
+// 4 bytes like the GeometryPool pads it, so both blobs map onto consecutive pool ranges as a whole
+struct MeshCacheContents
+{
+    std::vector<std::pair<std::string, Mesh>> meshes;
+    uint64_t triangleCount = 0;
+    uint64_t transformedVertexCountBefore = 0;
+    uint64_t transformedVertexCountAfter = 0;
+
+    uint64_t vertexDataSize = 0;
+    uint64_t indexDataSize = 0;
+    // Where the blobs start within the cache file
+    uint64_t vertexDataFileOffset = 0;
+    uint64_t indexDataFileOffset = 0;
+};
+
+std::filesystem::path GetMeshCachePath(const std::filesystem::path& cacheDirectory, const std::filesystem::path& sourcePath);
+
+// Reads everything but the blobs. Fails when the file is missing, was cooked by another converter
+// version or with other options, or when the source or a file it references changed since
+std::expected<MeshCacheContents, std::string> ReadMeshCache(
+    const std::filesystem::path& cachePath,
+    const std::filesystem::path& sourcePath,
+    VertexFormat vertexFormat,
+    bool isGeometryOptimized);
+
+// Copies the blobs from a mapping of the cache straight into their destinations, which may be write combined staging memory
+std::expected<void, std::string> ReadMeshCacheData(
+    const std::filesystem::path& cachePath,
+    const MeshCacheContents& contents,
+    void* vertexData,
+    void* indexData);
+
+std::expected<void, std::string> WriteMeshCache(
+    const std::filesystem::path& cachePath,
+    const std::filesystem::path& sourcePath,
+    VertexFormat vertexFormat,
+    bool isGeometryOptimized,
+    const MeshCacheContents& contents,
+    std::span<const std::byte> vertexData,
+    std::span<const std::byte> indexData);
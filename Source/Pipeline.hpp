@@ -2,8 +2,14 @@
 
 #include <volk.h>
 
+#include <cstdint>
+
 struct Pipeline
 {
 	VkPipeline pipeline = {};
 	VkPipelineLayout pipelineLayout = {};
-};
\ No newline at end of file
+};
+
+// Refers to a pipeline of the PipelineCompiler, which may still be compiling
+using PipelineHandle = uint32_t;
+constexpr PipelineHandle INVALID_PIPELINE_HANDLE = UINT32_MAX;
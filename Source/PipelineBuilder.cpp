@@ -1,7 +1,7 @@
 #include "PipelineBuilder.hpp"
-#include "Engine.hpp"
+#include "Io.hpp"
 
-#include <iostream>
+#include <algorithm>
 #include <format>
 
 VkPipelineShaderStageCreateInfo CreateShaderStageCreateInfo(VkShaderStageFlagBits stage, VkShaderModule shaderModule)
@@ -88,15 +88,7 @@ PipelineBuilder& PipelineBuilder::WithGraphicsShadingStages(
 
 PipelineBuilder& PipelineBuilder::WithVertexInput(const VertexInputDescription& vertexInputDescription)
 {
-    _vertexInputInfo = {};
-    _vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    _vertexInputInfo.pNext = nullptr;
-
-    _vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(vertexInputDescription.bindings.size());
-    _vertexInputInfo.pVertexBindingDescriptions = vertexInputDescription.bindings.data();
-    _vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexInputDescription.attributes.size());
-    _vertexInputInfo.pVertexAttributeDescriptions = vertexInputDescription.attributes.data();
-
+    _vertexInputDescription = vertexInputDescription;
     return *this;
 }
 
@@ -113,6 +105,13 @@ PipelineBuilder& PipelineBuilder::WithViewportAndScissor(VkViewport viewport, Vk
     return *this;
 }
 
+PipelineBuilder& PipelineBuilder::WithDynamicViewportAndScissor()
+{
+    _dynamicStates.push_back(VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT);
+    _dynamicStates.push_back(VkDynamicState::VK_DYNAMIC_STATE_SCISSOR);
+    return *this;
+}
+
 PipelineBuilder& PipelineBuilder::WithPolygonMode(VkPolygonMode polygonMode)
 {
     _rasterizer = CreateRasterizationStateCreateInfo(polygonMode);
@@ -147,61 +146,61 @@ PipelineBuilder& PipelineBuilder::WithDepthTestingEnabled(VkCompareOp compareOpe
     return *this;
 }
 
+PipelineBuilder& PipelineBuilder::WithDynamicCullMode()
+{
+    _dynamicStates.push_back(VkDynamicState::VK_DYNAMIC_STATE_CULL_MODE_EXT);
+    return *this;
+}
+
+PipelineBuilder& PipelineBuilder::WithDynamicDepthTest()
+{
+    _dynamicStates.push_back(VkDynamicState::VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+    _dynamicStates.push_back(VkDynamicState::VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT);
+    return *this;
+}
+
 PipelineBuilder& PipelineBuilder::WithDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout)
 {
     _descriptorSetLayouts.push_back(descriptorSetLayout);
     return *this;
 }
 
-std::expected<Pipeline, std::string> PipelineBuilder::Build(
-    const std::string& label,
-    VkDevice device,
-    VkRenderPass renderPass)
+VkPipelineVertexInputStateCreateInfo PipelineBuilder::CreateVertexInputStateCreateInfo() const
 {
-    if (_descriptorSetLayouts.empty())
-    {
-        return std::unexpected("Pipeline has no descriptor set layouts");
-    }
+    VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo = {};
+    pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    pipelineVertexInputStateCreateInfo.pNext = nullptr;
+
+    pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(_vertexInputDescription.bindings.size());
+    pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = _vertexInputDescription.bindings.data();
+    pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(_vertexInputDescription.attributes.size());
+    pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = _vertexInputDescription.attributes.data();
+    return pipelineVertexInputStateCreateInfo;
+}
 
+VkPushConstantRange PipelineBuilder::CreatePushConstantRange() const
+{
     VkPushConstantRange pushConstantRange = {};
     pushConstantRange.offset = 0;
     pushConstantRange.size = sizeof(GpuPushConstants);
     pushConstantRange.stageFlags = VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT;
+    return pushConstantRange;
+}
 
-    Pipeline pipeline;
-    if (vkCreatePipelineLayout(
-        device,
-        ToTempPtr(VkPipelineLayoutCreateInfo
-        {
-            .sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .pNext = nullptr,
-            .setLayoutCount = static_cast<uint32_t>(_descriptorSetLayouts.size()),
-            .pSetLayouts = _descriptorSetLayouts.data(),
-            .pushConstantRangeCount = 1,
-            .pPushConstantRanges = &pushConstantRange,
-        }),
-        nullptr,
-        &pipeline.pipelineLayout) != VK_SUCCESS)
-    {
-        return std::unexpected("Vulkan: Failed to create pipeline layout");
-    }
-
-    auto debugLabel = std::format("{}_PipelineLayout", label);
-    SetDebugName(device, pipeline.pipelineLayout, debugLabel);    
-
-    _deletionQueue.Push([=]()
-    {
-        vkDestroyPipelineLayout(device, pipeline.pipelineLayout, nullptr);
-    });
-
+VkPipelineViewportStateCreateInfo PipelineBuilder::CreateViewportStateCreateInfo() const
+{
     VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo = {};
     pipelineViewportStateCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     pipelineViewportStateCreateInfo.pNext = nullptr;
     pipelineViewportStateCreateInfo.viewportCount = 1;
-    pipelineViewportStateCreateInfo.pViewports = &_viewport;
+    pipelineViewportStateCreateInfo.pViewports = IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT) ? nullptr : &_viewport;
     pipelineViewportStateCreateInfo.scissorCount = 1;
-    pipelineViewportStateCreateInfo.pScissors = &_scissor;
+    pipelineViewportStateCreateInfo.pScissors = IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_SCISSOR) ? nullptr : &_scissor;
+    return pipelineViewportStateCreateInfo;
+}
 
+VkPipelineColorBlendStateCreateInfo PipelineBuilder::CreateColorBlendStateCreateInfo() const
+{
     VkPipelineColorBlendStateCreateInfo pipelineColorBlendStateCreateInfo = {};
     pipelineColorBlendStateCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     pipelineColorBlendStateCreateInfo.pNext = nullptr;
@@ -209,43 +208,272 @@ std::expected<Pipeline, std::string> PipelineBuilder::Build(
     pipelineColorBlendStateCreateInfo.logicOp = VK_LOGIC_OP_COPY;
     pipelineColorBlendStateCreateInfo.attachmentCount = 1;
     pipelineColorBlendStateCreateInfo.pAttachments = &_colorBlendAttachment;
+    return pipelineColorBlendStateCreateInfo;
+}
+
+VkPipelineDynamicStateCreateInfo PipelineBuilder::CreateDynamicStateCreateInfo(std::span<const VkDynamicState> dynamicStates) const
+{
+    VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo = {};
+    pipelineDynamicStateCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    pipelineDynamicStateCreateInfo.pNext = nullptr;
+    pipelineDynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    pipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
+    return pipelineDynamicStateCreateInfo;
+}
+
+bool PipelineBuilder::IsDynamic(VkDynamicState dynamicState) const
+{
+    return std::find(_dynamicStates.begin(), _dynamicStates.end(), dynamicState) != _dynamicStates.end();
+}
+
+namespace
+{
+    // Vulkan's state structs have padding, so part keys are hashed field by field
+    template<typename T>
+    uint64_t HashValue(uint64_t hash, const T& value)
+    {
+        return HashBytes(std::as_bytes(std::span(&value, 1)), hash);
+    }
+
+    template<typename T>
+    uint64_t HashValues(uint64_t hash, const std::vector<T>& values)
+    {
+        return HashBytes(std::as_bytes(std::span(values)), HashValue(hash, values.size()));
+    }
+
+    bool IsExtendedDynamicState(VkDynamicState dynamicState)
+    {
+        return
+            dynamicState == VkDynamicState::VK_DYNAMIC_STATE_CULL_MODE_EXT ||
+            dynamicState == VkDynamicState::VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT ||
+            dynamicState == VkDynamicState::VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
+    }
+
+    // Which library part a dynamic state has to be declared in
+    bool IsFragmentShaderDynamicState(VkDynamicState dynamicState)
+    {
+        return
+            dynamicState == VkDynamicState::VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT ||
+            dynamicState == VkDynamicState::VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT;
+    }
+
+    VkShaderModule FindShaderModule(const std::vector<VkPipelineShaderStageCreateInfo>& shaderStages, VkShaderStageFlagBits stage)
+    {
+        for (auto& shaderStage : shaderStages)
+        {
+            if (shaderStage.stage == stage)
+            {
+                return shaderStage.module;
+            }
+        }
 
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-    pipelineCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.pNext = nullptr;
-    pipelineCreateInfo.stageCount = static_cast<uint32_t>(_shaderStages.size());
-    pipelineCreateInfo.pStages = _shaderStages.data();
-    pipelineCreateInfo.pVertexInputState = &_vertexInputInfo;
-    pipelineCreateInfo.pInputAssemblyState = &_inputAssembly;
-    pipelineCreateInfo.pViewportState = &pipelineViewportStateCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &_rasterizer;
-    pipelineCreateInfo.pMultisampleState = &_multisampling;
-    pipelineCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &_depthStencil;
-    pipelineCreateInfo.layout = pipeline.pipelineLayout;
-    pipelineCreateInfo.renderPass = renderPass;
-    pipelineCreateInfo.subpass = 0;
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-    if (vkCreateGraphicsPipelines(
-        device,
-        VK_NULL_HANDLE,
-        1,
-        &pipelineCreateInfo,
-        nullptr,
-        &pipeline.pipeline) != VK_SUCCESS)
-    {
-        pipeline.pipeline = VK_NULL_HANDLE;
-        return std::unexpected("PipelineBuilder: Failed to create pipeline");
-    }
-
-    debugLabel = std::format("{}_Pipeline", label);
-    SetDebugName(device, pipeline.pipeline, debugLabel);    
-
-    _deletionQueue.Push([=]()
-    {
-        vkDestroyPipeline(device, pipeline.pipeline, nullptr);
-    });
-
-    return pipeline;   
-}
\ No newline at end of file
+        return VK_NULL_HANDLE;
+    }
+}
+
+std::expected<LinkedPipeline, std::string> PipelineBuilder::BuildFromLibraries(
+    const std::string& label,
+    VkRenderPass renderPass,
+    PipelineLibraryCache& pipelineLibraryCache)
+{
+    if (_descriptorSetLayouts.empty())
+    {
+        return std::unexpected("Pipeline has no descriptor set layouts");
+    }
+
+    auto vertexShaderModule = FindShaderModule(_shaderStages, VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT);
+    auto fragmentShaderModule = FindShaderModule(_shaderStages, VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT);
+    if (vertexShaderModule == VK_NULL_HANDLE || fragmentShaderModule == VK_NULL_HANDLE)
+    {
+        return std::unexpected("PipelineBuilder: Pipeline libraries need a vertex and a fragment shader");
+    }
+
+    if (!pipelineLibraryCache.IsExtendedDynamicStateEnabled() &&
+        std::any_of(_dynamicStates.begin(), _dynamicStates.end(), IsExtendedDynamicState))
+    {
+        return std::unexpected("PipelineBuilder: Dynamic cull mode and depth test need VK_EXT_extended_dynamic_state");
+    }
+
+    auto pushConstantRange = CreatePushConstantRange();
+
+    LinkedPipeline linkedPipeline;
+    auto pipelineLayoutResult = pipelineLibraryCache.GetOrCreatePipelineLayout(
+        _descriptorSetLayouts,
+        std::span(&pushConstantRange, 1),
+        std::format("{}_PipelineLayout", label));
+    if (!pipelineLayoutResult.has_value())
+    {
+        return std::unexpected(pipelineLayoutResult.error());
+    }
+
+    linkedPipeline.pipeline.pipelineLayout = pipelineLayoutResult.value();
+
+    auto pipelineVertexInputStateCreateInfo = CreateVertexInputStateCreateInfo();
+    auto vertexShaderStage = CreateShaderStageCreateInfo(VkShaderStageFlagBits::VK_SHADER_STAGE_VERTEX_BIT, vertexShaderModule);
+    auto fragmentShaderStage = CreateShaderStageCreateInfo(VkShaderStageFlagBits::VK_SHADER_STAGE_FRAGMENT_BIT, fragmentShaderModule);
+    auto pipelineViewportStateCreateInfo = CreateViewportStateCreateInfo();
+    auto pipelineColorBlendStateCreateInfo = CreateColorBlendStateCreateInfo();
+
+    // Handles are part of the keys, the cache is only valid as long as the shader modules, layouts and render
+    // passes it was fed live
+    auto emptyHash = HashBytes({});
+    auto layoutHash = HashValue(emptyHash, linkedPipeline.pipeline.pipelineLayout);
+    auto renderPassHash = HashValue(layoutHash, renderPass);
+
+    auto vertexInputKey = HashValues(emptyHash, _vertexInputDescription.bindings);
+    vertexInputKey = HashValues(vertexInputKey, _vertexInputDescription.attributes);
+    vertexInputKey = HashValue(vertexInputKey, _inputAssembly.topology);
+    vertexInputKey = HashValue(vertexInputKey, _inputAssembly.primitiveRestartEnable);
+
+    // Dynamic state goes into the part it belongs to, its baked value must not split parts up
+    std::vector<VkDynamicState> preRasterizationDynamicStates;
+    std::vector<VkDynamicState> fragmentShaderDynamicStates;
+    for (auto dynamicState : _dynamicStates)
+    {
+        if (IsFragmentShaderDynamicState(dynamicState))
+        {
+            fragmentShaderDynamicStates.push_back(dynamicState);
+        }
+        else
+        {
+            preRasterizationDynamicStates.push_back(dynamicState);
+        }
+    }
+
+    auto preRasterizationKey = HashValue(renderPassHash, vertexShaderModule);
+    preRasterizationKey = HashValues(preRasterizationKey, preRasterizationDynamicStates);
+    if (!IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_VIEWPORT))
+    {
+        preRasterizationKey = HashValue(preRasterizationKey, _viewport);
+    }
+
+    if (!IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_SCISSOR))
+    {
+        preRasterizationKey = HashValue(preRasterizationKey, _scissor);
+    }
+
+    if (!IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_CULL_MODE_EXT))
+    {
+        preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.cullMode);
+    }
+
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.depthClampEnable);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.rasterizerDiscardEnable);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.polygonMode);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.frontFace);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.depthBiasEnable);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.depthBiasConstantFactor);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.depthBiasClamp);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.depthBiasSlopeFactor);
+    preRasterizationKey = HashValue(preRasterizationKey, _rasterizer.lineWidth);
+
+    auto multisampleKey = HashValue(emptyHash, _multisampling.rasterizationSamples);
+    multisampleKey = HashValue(multisampleKey, _multisampling.sampleShadingEnable);
+    multisampleKey = HashValue(multisampleKey, _multisampling.minSampleShading);
+    multisampleKey = HashValue(multisampleKey, _multisampling.alphaToCoverageEnable);
+    multisampleKey = HashValue(multisampleKey, _multisampling.alphaToOneEnable);
+
+    auto fragmentShaderKey = HashValue(renderPassHash, fragmentShaderModule);
+    fragmentShaderKey = HashValue(fragmentShaderKey, multisampleKey);
+    fragmentShaderKey = HashValues(fragmentShaderKey, fragmentShaderDynamicStates);
+    if (!IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT))
+    {
+        fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.depthTestEnable);
+    }
+
+    if (!IsDynamic(VkDynamicState::VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT))
+    {
+        fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.depthCompareOp);
+    }
+
+    fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.depthWriteEnable);
+    fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.depthBoundsTestEnable);
+    fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.stencilTestEnable);
+    fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.minDepthBounds);
+    fragmentShaderKey = HashValue(fragmentShaderKey, _depthStencil.maxDepthBounds);
+
+    auto fragmentOutputKey = HashValue(HashValue(emptyHash, renderPass), multisampleKey);
+    fragmentOutputKey = HashValue(fragmentOutputKey, _colorBlendAttachment);
+
+    auto preRasterizationDynamicStateCreateInfo = CreateDynamicStateCreateInfo(preRasterizationDynamicStates);
+    auto fragmentShaderDynamicStateCreateInfo = CreateDynamicStateCreateInfo(fragmentShaderDynamicStates);
+
+    VkGraphicsPipelineCreateInfo vertexInputCreateInfo = {};
+    vertexInputCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    vertexInputCreateInfo.pVertexInputState = &pipelineVertexInputStateCreateInfo;
+    vertexInputCreateInfo.pInputAssemblyState = &_inputAssembly;
+
+    VkGraphicsPipelineCreateInfo preRasterizationCreateInfo = {};
+    preRasterizationCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    preRasterizationCreateInfo.stageCount = 1;
+    preRasterizationCreateInfo.pStages = &vertexShaderStage;
+    preRasterizationCreateInfo.pViewportState = &pipelineViewportStateCreateInfo;
+    preRasterizationCreateInfo.pRasterizationState = &_rasterizer;
+    preRasterizationCreateInfo.pDynamicState = &preRasterizationDynamicStateCreateInfo;
+    preRasterizationCreateInfo.layout = linkedPipeline.pipeline.pipelineLayout;
+    preRasterizationCreateInfo.renderPass = renderPass;
+    preRasterizationCreateInfo.subpass = 0;
+
+    VkGraphicsPipelineCreateInfo fragmentShaderCreateInfo = {};
+    fragmentShaderCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    fragmentShaderCreateInfo.stageCount = 1;
+    fragmentShaderCreateInfo.pStages = &fragmentShaderStage;
+    fragmentShaderCreateInfo.pMultisampleState = &_multisampling;
+    fragmentShaderCreateInfo.pDepthStencilState = &_depthStencil;
+    fragmentShaderCreateInfo.pDynamicState = &fragmentShaderDynamicStateCreateInfo;
+    fragmentShaderCreateInfo.layout = linkedPipeline.pipeline.pipelineLayout;
+    fragmentShaderCreateInfo.renderPass = renderPass;
+    fragmentShaderCreateInfo.subpass = 0;
+
+    VkGraphicsPipelineCreateInfo fragmentOutputCreateInfo = {};
+    fragmentOutputCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    fragmentOutputCreateInfo.pMultisampleState = &_multisampling;
+    fragmentOutputCreateInfo.pColorBlendState = &pipelineColorBlendStateCreateInfo;
+    fragmentOutputCreateInfo.renderPass = renderPass;
+    fragmentOutputCreateInfo.subpass = 0;
+
+    const std::pair<uint64_t, const VkGraphicsPipelineCreateInfo*> parts[PIPELINE_LIBRARY_PART_COUNT] =
+    {
+        { vertexInputKey, &vertexInputCreateInfo },
+        { preRasterizationKey, &preRasterizationCreateInfo },
+        { fragmentShaderKey, &fragmentShaderCreateInfo },
+        { fragmentOutputKey, &fragmentOutputCreateInfo },
+    };
+
+    constexpr const char* partLabels[PIPELINE_LIBRARY_PART_COUNT] =
+    {
+        "VertexInput",
+        "PreRasterization",
+        "FragmentShader",
+        "FragmentOutput"
+    };
+
+    for (size_t partIndex = 0; partIndex < PIPELINE_LIBRARY_PART_COUNT; partIndex++)
+    {
+        auto libraryResult = pipelineLibraryCache.GetOrCreateLibrary(
+            static_cast<PipelineLibraryPart>(partIndex),
+            parts[partIndex].first,
+            *parts[partIndex].second,
+            std::format("{}_{}Library", label, partLabels[partIndex]));
+        if (!libraryResult.has_value())
+        {
+            return std::unexpected(libraryResult.error());
+        }
+
+        linkedPipeline.libraries[partIndex] = libraryResult.value();
+    }
+
+    auto pipelineResult = pipelineLibraryCache.Link(
+        linkedPipeline.libraries,
+        linkedPipeline.pipeline.pipelineLayout,
+        false,
+        std::format("{}_Pipeline", label));
+    if (!pipelineResult.has_value())
+    {
+        return std::unexpected(pipelineResult.error());
+    }
+
+    linkedPipeline.pipeline.pipeline = pipelineResult.value();
+
+    return linkedPipeline;
+}
@@ -1,42 +1,54 @@
 #pragma once
 
 #include <volk.h>
+#include <span>
 #include <vector>
 #include <expected>
 #include <string>
 
-#include "DeletionQueue.hpp"
 #include "Types.hpp"
 #include "Pipeline.hpp"
+#include "PipelineLibrary.hpp"
+
+// A pipeline linked from library parts, the parts can be linked again with link time optimization
+struct LinkedPipeline
+{
+    Pipeline pipeline;
+    PipelineLibraries libraries = {};
+};
 
 class PipelineBuilder
 {
 public:
-    PipelineBuilder(DeletionQueue& deletionQueue)
-        : _deletionQueue(deletionQueue)
-    {
-    }
-
     PipelineBuilder& WithGraphicsShadingStages(VkShaderModule vertexShaderModule, VkShaderModule fragmentShaderModule);
     PipelineBuilder& WithVertexInput(const VertexInputDescription& vertexInputDescription);
     PipelineBuilder& WithTopology(VkPrimitiveTopology primitiveTopology);
     PipelineBuilder& WithViewportAndScissor(VkViewport viewport, VkRect2D scissor);
+    // Viewport and scissor are set on the command buffer, so the pipeline survives resizes
+    PipelineBuilder& WithDynamicViewportAndScissor();
     PipelineBuilder& WithPolygonMode(VkPolygonMode polygonMode);    
     PipelineBuilder& WithoutMultisampling();
     PipelineBuilder& WithoutBlending();
     PipelineBuilder& WithDepthTestingEnabled(VkCompareOp compareOperation = VkCompareOp::VK_COMPARE_OP_LESS);
+    // VK_EXT_extended_dynamic_state, one pipeline covers what would otherwise be a permutation each.
+    // The values WithPolygonMode and WithDepthTestingEnabled baked in are ignored for these.
+    // Building fails on devices without the extension
+    PipelineBuilder& WithDynamicCullMode();
+    PipelineBuilder& WithDynamicDepthTest();
     PipelineBuilder& WithDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout);
 
-    std::expected<Pipeline, std::string> Build(
+    // Creates or reuses the four library parts and links them without link time optimization where
+    // the device links fast, so new permutations only pay for parts whose state is new. The layout
+    // and parts belong to the cache, the caller owns the linked pipeline. Touches nothing but the
+    // cache, so builders can be copied to and built on any thread
+    std::expected<LinkedPipeline, std::string> BuildFromLibraries(
         const std::string& label,
-        VkDevice device,
-        VkRenderPass renderPass);
+        VkRenderPass renderPass,
+        PipelineLibraryCache& pipelineLibraryCache);
 
 private:
-    DeletionQueue& _deletionQueue;
-
     std::vector<VkPipelineShaderStageCreateInfo> _shaderStages;
-    VkPipelineVertexInputStateCreateInfo _vertexInputInfo;
+    VertexInputDescription _vertexInputDescription;
     VkPipelineInputAssemblyStateCreateInfo _inputAssembly;
     VkViewport _viewport;
     VkRect2D _scissor;
@@ -45,4 +57,13 @@ private:
     VkPipelineColorBlendAttachmentState _colorBlendAttachment;
     VkPipelineMultisampleStateCreateInfo _multisampling;
     std::vector<VkDescriptorSetLayout> _descriptorSetLayouts;
+    std::vector<VkDynamicState> _dynamicStates;
+
+    bool IsDynamic(VkDynamicState dynamicState) const;
+
+    VkPipelineVertexInputStateCreateInfo CreateVertexInputStateCreateInfo() const;
+    VkPushConstantRange CreatePushConstantRange() const;
+    VkPipelineViewportStateCreateInfo CreateViewportStateCreateInfo() const;
+    VkPipelineColorBlendStateCreateInfo CreateColorBlendStateCreateInfo() const;
+    VkPipelineDynamicStateCreateInfo CreateDynamicStateCreateInfo(std::span<const VkDynamicState> dynamicStates) const;
 };
\ No newline at end of file
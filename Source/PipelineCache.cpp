@@ -0,0 +1,132 @@
+#include "PipelineCache.hpp"
+#include "Io.hpp"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace
+{
+    constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x504b5546; // FUKP
+    constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+    // Vulkan's own header has no driver version, drivers are expected to reject foreign data
+    // themselves, but not all of them do so gracefully
+    struct PipelineCacheFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorId;
+        uint32_t deviceId;
+        uint32_t driverVersion;
+        uint8_t pipelineCacheUuid[VK_UUID_SIZE];
+        uint64_t dataSize;
+        uint64_t dataHash;
+    };
+
+    PipelineCacheFileHeader CreateFileHeader(const VkPhysicalDeviceProperties& physicalDeviceProperties)
+    {
+        // Zeroed padding, so headers of the same device compare equal byte for byte
+        PipelineCacheFileHeader fileHeader;
+        std::memset(&fileHeader, 0, sizeof(fileHeader));
+        fileHeader.magic = PIPELINE_CACHE_MAGIC;
+        fileHeader.version = PIPELINE_CACHE_VERSION;
+        fileHeader.vendorId = physicalDeviceProperties.vendorID;
+        fileHeader.deviceId = physicalDeviceProperties.deviceID;
+        fileHeader.driverVersion = physicalDeviceProperties.driverVersion;
+        std::memcpy(fileHeader.pipelineCacheUuid, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+        return fileHeader;
+    }
+}
+
+std::expected<std::vector<std::byte>, std::string> ReadPipelineCacheData(
+    const std::filesystem::path& cachePath,
+    const VkPhysicalDeviceProperties& physicalDeviceProperties)
+{
+    auto cacheFileResult = MappedFile::Open(cachePath);
+    if (!cacheFileResult.has_value())
+    {
+        return std::unexpected(std::format("PipelineCache: No cache at {}", cachePath.string()));
+    }
+
+    auto& cacheFile = cacheFileResult.value();
+    if (cacheFile.GetSize() < sizeof(PipelineCacheFileHeader))
+    {
+        return std::unexpected(std::format("PipelineCache: {} is truncated", cachePath.string()));
+    }
+
+    PipelineCacheFileHeader fileHeader;
+    std::memcpy(&fileHeader, cacheFile.GetData(), sizeof(fileHeader));
+
+    auto expectedFileHeader = CreateFileHeader(physicalDeviceProperties);
+    expectedFileHeader.dataSize = fileHeader.dataSize;
+    expectedFileHeader.dataHash = fileHeader.dataHash;
+    if (std::memcmp(&fileHeader, &expectedFileHeader, sizeof(fileHeader)) != 0)
+    {
+        return std::unexpected(std::format("PipelineCache: {} was written by another device or driver", cachePath.string()));
+    }
+
+    auto pipelineCacheData = cacheFile.GetBytes().subspan(sizeof(PipelineCacheFileHeader));
+    if (pipelineCacheData.size() != fileHeader.dataSize ||
+        HashBytes(pipelineCacheData) != fileHeader.dataHash)
+    {
+        return std::unexpected(std::format("PipelineCache: {} is damaged", cachePath.string()));
+    }
+
+    // The data has to start with the header version one layout of the same device
+    VkPipelineCacheHeaderVersionOne pipelineCacheHeader = {};
+    if (pipelineCacheData.size() < sizeof(pipelineCacheHeader))
+    {
+        return std::unexpected(std::format("PipelineCache: {} is damaged", cachePath.string()));
+    }
+
+    std::memcpy(&pipelineCacheHeader, pipelineCacheData.data(), sizeof(pipelineCacheHeader));
+    if (pipelineCacheHeader.headerVersion != VkPipelineCacheHeaderVersion::VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+        pipelineCacheHeader.vendorID != physicalDeviceProperties.vendorID ||
+        pipelineCacheHeader.deviceID != physicalDeviceProperties.deviceID ||
+        std::memcmp(pipelineCacheHeader.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        return std::unexpected(std::format("PipelineCache: {} was written by another device or driver", cachePath.string()));
+    }
+
+    return std::vector<std::byte>(pipelineCacheData.begin(), pipelineCacheData.end());
+}
+
+std::expected<void, std::string> WritePipelineCacheData(
+    const std::filesystem::path& cachePath,
+    const VkPhysicalDeviceProperties& physicalDeviceProperties,
+    std::span<const std::byte> pipelineCacheData)
+{
+    auto fileHeader = CreateFileHeader(physicalDeviceProperties);
+    fileHeader.dataSize = pipelineCacheData.size();
+    fileHeader.dataHash = HashBytes(pipelineCacheData);
+
+    std::error_code errorCode;
+    std::filesystem::create_directories(cachePath.parent_path(), errorCode);
+
+    // Written next to the cache and renamed over it, so a cache file is either complete or missing
+    auto temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            return std::unexpected(std::format("PipelineCache: Unable to create {}", temporaryPath.string()));
+        }
+
+        file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+        file.write(reinterpret_cast<const char*>(pipelineCacheData.data()), static_cast<std::streamsize>(pipelineCacheData.size()));
+        if (!file)
+        {
+            return std::unexpected(std::format("PipelineCache: Unable to write {}", temporaryPath.string()));
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, cachePath, errorCode);
+    if (errorCode)
+    {
+        return std::unexpected(std::format("PipelineCache: Unable to replace {}: {}", cachePath.string(), errorCode.message()));
+    }
+
+    return {};
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// VkPipelineCache data is only usable by the device and driver which produced it. Fails when the file
+// is missing, damaged, or was written on another device, driver version or pipeline cache UUID
+std::expected<std::vector<std::byte>, std::string> ReadPipelineCacheData(
+    const std::filesystem::path& cachePath,
+    const VkPhysicalDeviceProperties& physicalDeviceProperties);
+
+std::expected<void, std::string> WritePipelineCacheData(
+    const std::filesystem::path& cachePath,
+    const VkPhysicalDeviceProperties& physicalDeviceProperties,
+    std::span<const std::byte> pipelineCacheData);
@@ -0,0 +1,165 @@
+#include "PipelineCompiler.hpp"
+
+#include <tracy/Tracy.hpp>
+
+#include <chrono>
+#include <format>
+#include <iostream>
+
+bool PipelineCompiler::Initialize(
+    VkDevice device,
+    JobSystem& jobSystem,
+    PipelineLibraryCache& pipelineLibraryCache,
+    bool optimizeInBackground)
+{
+    _device = device;
+    _jobSystem = &jobSystem;
+    _pipelineLibraryCache = &pipelineLibraryCache;
+    _optimizeInBackground = optimizeInBackground;
+    return true;
+}
+
+void PipelineCompiler::Destroy()
+{
+    // Jobs still running hold on to this and to the library parts
+    _jobSystem->Wait(_compileCounter);
+    _jobSystem->Wait(_optimizationCounter);
+    Commit();
+
+    for (auto pipeline : _createdPipelines)
+    {
+        vkDestroyPipeline(_device, pipeline, nullptr);
+    }
+
+    _createdPipelines.clear();
+    _pipelines.clear();
+}
+
+PipelineHandle PipelineCompiler::Request(const std::string& label, const PipelineBuilder& pipelineBuilder, VkRenderPass renderPass)
+{
+    auto pipelineHandle = static_cast<PipelineHandle>(_pipelines.size());
+    _pipelines.emplace_back();
+
+    _jobSystem->Schedule(_compileCounter, [this, pipelineHandle, label, pipelineBuilder, renderPass]() mutable
+    {
+        ZoneScopedN("CompilePipeline");
+
+        auto compileStartTime = std::chrono::steady_clock::now();
+        auto linkedPipelineResult = pipelineBuilder.BuildFromLibraries(label, renderPass, *_pipelineLibraryCache);
+        if (!linkedPipelineResult.has_value())
+        {
+            std::cerr << linkedPipelineResult.error() << "\n";
+            return;
+        }
+
+        auto& linkedPipeline = linkedPipelineResult.value();
+        auto compileTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compileStartTime).count();
+
+        {
+            std::lock_guard lock(_compiledPipelinesMutex);
+            _compiledPipelines.push_back(CompiledPipeline
+            {
+                .pipelineHandle = pipelineHandle,
+                .pipeline = linkedPipeline.pipeline,
+                .isOptimized = false,
+                .compileTimeMs = compileTimeMs,
+            });
+        }
+
+        // Scheduled once the fast linked pipeline is handed over, so Commit always sees that one first.
+        // Without fast linking the first link already was the optimized one
+        if (_optimizeInBackground && _pipelineLibraryCache->IsFastLinkingSupported())
+        {
+            ScheduleOptimizedLink(pipelineHandle, linkedPipeline.pipeline, linkedPipeline.libraries, label);
+        }
+    });
+
+    return pipelineHandle;
+}
+
+void PipelineCompiler::ScheduleOptimizedLink(
+    PipelineHandle pipelineHandle,
+    const Pipeline& fastLinkedPipeline,
+    const PipelineLibraries& libraries,
+    const std::string& label)
+{
+    _jobSystem->ScheduleBackground(_optimizationCounter, [this, pipelineHandle, fastLinkedPipeline, libraries, label]()
+    {
+        ZoneScopedN("LinkOptimizedPipeline");
+
+        auto pipelineResult = _pipelineLibraryCache->Link(
+            libraries,
+            fastLinkedPipeline.pipelineLayout,
+            true,
+            std::format("{}_OptimizedPipeline", label));
+        if (!pipelineResult.has_value())
+        {
+            // Not fatal, the fast linked pipeline simply stays in use
+            std::cerr << pipelineResult.error() << "\n";
+            return;
+        }
+
+        std::lock_guard lock(_compiledPipelinesMutex);
+        _compiledPipelines.push_back(CompiledPipeline
+        {
+            .pipelineHandle = pipelineHandle,
+            .pipeline =
+            {
+                .pipeline = pipelineResult.value(),
+                .pipelineLayout = fastLinkedPipeline.pipelineLayout,
+            },
+            .isOptimized = true,
+        });
+    });
+}
+
+void PipelineCompiler::Commit()
+{
+    ZoneScoped;
+
+    std::vector<CompiledPipeline> compiledPipelines;
+    {
+        std::lock_guard lock(_compiledPipelinesMutex);
+        compiledPipelines.swap(_compiledPipelines);
+    }
+
+    for (auto& compiledPipeline : compiledPipelines)
+    {
+        _createdPipelines.push_back(compiledPipeline.pipeline.pipeline);
+        _pipelines[compiledPipeline.pipelineHandle] = compiledPipeline.pipeline;
+
+        if (!compiledPipeline.isOptimized)
+        {
+            _compileTimeMs += compiledPipeline.compileTimeMs;
+            _compiledPipelineCount++;
+        }
+    }
+}
+
+void PipelineCompiler::Wait()
+{
+    // Optimized links are scheduled by the compile jobs, once those are done every one of them exists
+    _jobSystem->Wait(_compileCounter);
+    _jobSystem->Wait(_optimizationCounter);
+    Commit();
+}
+
+const Pipeline* PipelineCompiler::GetPipeline(PipelineHandle pipelineHandle) const
+{
+    if (pipelineHandle >= _pipelines.size() || _pipelines[pipelineHandle].pipeline == VK_NULL_HANDLE)
+    {
+        return nullptr;
+    }
+
+    return &_pipelines[pipelineHandle];
+}
+
+double PipelineCompiler::GetCompileTimeMs() const
+{
+    return _compileTimeMs;
+}
+
+uint32_t PipelineCompiler::GetCompiledPipelineCount() const
+{
+    return _compiledPipelineCount;
+}
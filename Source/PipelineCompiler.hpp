@@ -0,0 +1,77 @@
+#pragma once
+
+#include <volk.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "JobSystem.hpp"
+#include "Pipeline.hpp"
+#include "PipelineBuilder.hpp"
+#include "PipelineLibrary.hpp"
+
+// Compiles pipelines on the JobSystem's workers, from cached library parts and the shared VkPipelineCache,
+// so loads compile as many pipelines at once as there are cores. Handles resolve once Commit picked
+// the compiled pipeline up, until then GetPipeline returns nullptr. Everything but the compiling
+// itself belongs to the main thread
+class PipelineCompiler
+{
+public:
+    bool Initialize(
+        VkDevice device,
+        JobSystem& jobSystem,
+        PipelineLibraryCache& pipelineLibraryCache,
+        bool optimizeInBackground);
+    // Waits for compiles still in flight and destroys every pipeline it created
+    void Destroy();
+
+    // The builder is copied to the worker, the handle stays valid for as long as the compiler lives.
+    // A pipeline which fails to compile never resolves
+    PipelineHandle Request(const std::string& label, const PipelineBuilder& pipelineBuilder, VkRenderPass renderPass);
+    // Makes compiled pipelines visible and swaps optimized ones in for their fast linked versions
+    void Commit();
+    // Helps compiling until every requested pipeline is committed in its final form, optimized versions
+    // included, so frames drawn afterwards never switch pipelines mid measurement
+    void Wait();
+
+    const Pipeline* GetPipeline(PipelineHandle pipelineHandle) const;
+
+    // Summed over all workers, so it can exceed the wall time
+    double GetCompileTimeMs() const;
+    uint32_t GetCompiledPipelineCount() const;
+
+private:
+    struct CompiledPipeline
+    {
+        PipelineHandle pipelineHandle = INVALID_PIPELINE_HANDLE;
+        Pipeline pipeline;
+        bool isOptimized = false;
+        double compileTimeMs = 0.0;
+    };
+
+    void ScheduleOptimizedLink(
+        PipelineHandle pipelineHandle,
+        const Pipeline& fastLinkedPipeline,
+        const PipelineLibraries& libraries,
+        const std::string& label);
+
+    VkDevice _device{VK_NULL_HANDLE};
+    JobSystem* _jobSystem{nullptr};
+    PipelineLibraryCache* _pipelineLibraryCache{nullptr};
+    bool _optimizeInBackground{true};
+
+    // Indexed by handle, pipeline is VK_NULL_HANDLE until committed
+    std::vector<Pipeline> _pipelines;
+    // Replaced fast linked pipelines stay here too, frames in flight may still use them
+    std::vector<VkPipeline> _createdPipelines;
+
+    JobCounter _compileCounter;
+    JobCounter _optimizationCounter;
+    std::mutex _compiledPipelinesMutex;
+    std::vector<CompiledPipeline> _compiledPipelines;
+
+    double _compileTimeMs{0.0};
+    uint32_t _compiledPipelineCount{0};
+};
@@ -0,0 +1,219 @@
+#include "PipelineLibrary.hpp"
+#include "DebugName.hpp"
+#include "Io.hpp"
+
+#include <format>
+
+namespace
+{
+    constexpr VkGraphicsPipelineLibraryFlagsEXT ToGraphicsPipelineLibraryFlags(PipelineLibraryPart part)
+    {
+        switch (part)
+        {
+            case PipelineLibraryPart::VertexInput:
+                return VkGraphicsPipelineLibraryFlagBitsEXT::VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+            case PipelineLibraryPart::PreRasterization:
+                return VkGraphicsPipelineLibraryFlagBitsEXT::VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+            case PipelineLibraryPart::FragmentShader:
+                return VkGraphicsPipelineLibraryFlagBitsEXT::VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+            case PipelineLibraryPart::FragmentOutput:
+                return VkGraphicsPipelineLibraryFlagBitsEXT::VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+        }
+
+        return 0;
+    }
+}
+
+bool PipelineLibraryCache::Initialize(
+    VkPhysicalDevice physicalDevice,
+    VkDevice device,
+    VkPipelineCache pipelineCache,
+    bool isExtendedDynamicStateEnabled)
+{
+    _device = device;
+    _pipelineCache = pipelineCache;
+    _isExtendedDynamicStateEnabled = isExtendedDynamicStateEnabled;
+
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT graphicsPipelineLibraryProperties =
+    {
+        .sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT,
+        .pNext = nullptr,
+    };
+
+    vkGetPhysicalDeviceProperties2(physicalDevice, ToTempPtr(VkPhysicalDeviceProperties2
+    {
+        .sType = VkStructureType::VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &graphicsPipelineLibraryProperties,
+    }));
+
+    _isFastLinkingSupported = graphicsPipelineLibraryProperties.graphicsPipelineLibraryFastLinking == VK_TRUE;
+
+    return true;
+}
+
+void PipelineLibraryCache::Destroy()
+{
+    std::lock_guard lock(_mutex);
+
+    for (auto& [key, entry] : _libraries)
+    {
+        vkDestroyPipeline(_device, entry->handle, nullptr);
+    }
+
+    for (auto& [key, entry] : _pipelineLayouts)
+    {
+        vkDestroyPipelineLayout(_device, entry->handle, nullptr);
+    }
+
+    _libraries.clear();
+    _pipelineLayouts.clear();
+}
+
+bool PipelineLibraryCache::IsFastLinkingSupported() const
+{
+    return _isFastLinkingSupported;
+}
+
+bool PipelineLibraryCache::IsExtendedDynamicStateEnabled() const
+{
+    return _isExtendedDynamicStateEnabled;
+}
+
+std::expected<VkPipeline, std::string> PipelineLibraryCache::GetOrCreateLibrary(
+    PipelineLibraryPart part,
+    uint64_t key,
+    const VkGraphicsPipelineCreateInfo& createInfo,
+    const std::string& label)
+{
+    key = HashBytes(std::as_bytes(std::span(&part, 1)), key);
+
+    std::shared_ptr<Entry<VkPipeline>> entry;
+    {
+        std::lock_guard lock(_mutex);
+        auto& cachedEntry = _libraries[key];
+        if (cachedEntry == nullptr)
+        {
+            cachedEntry = std::make_shared<Entry<VkPipeline>>();
+        }
+
+        entry = cachedEntry;
+    }
+
+    std::call_once(entry->createOnce, [&]()
+    {
+        VkGraphicsPipelineLibraryCreateInfoEXT graphicsPipelineLibraryCreateInfo =
+        {
+            .sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+            .pNext = createInfo.pNext,
+            .flags = ToGraphicsPipelineLibraryFlags(part),
+        };
+
+        // Libraries keep what link time optimization needs, so the optimized link does not start over
+        auto libraryCreateInfo = createInfo;
+        libraryCreateInfo.pNext = &graphicsPipelineLibraryCreateInfo;
+        libraryCreateInfo.flags |=
+            VkPipelineCreateFlagBits::VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+            VkPipelineCreateFlagBits::VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+        if (vkCreateGraphicsPipelines(_device, _pipelineCache, 1, &libraryCreateInfo, nullptr, &entry->handle) != VK_SUCCESS)
+        {
+            entry->handle = VK_NULL_HANDLE;
+            entry->error = std::format("PipelineLibraryCache: Failed to create {}", label);
+            return;
+        }
+
+        SetDebugName(_device, entry->handle, label);
+    });
+
+    if (entry->handle == VK_NULL_HANDLE)
+    {
+        return std::unexpected(entry->error);
+    }
+
+    return entry->handle;
+}
+
+std::expected<VkPipelineLayout, std::string> PipelineLibraryCache::GetOrCreatePipelineLayout(
+    std::span<const VkDescriptorSetLayout> descriptorSetLayouts,
+    std::span<const VkPushConstantRange> pushConstantRanges,
+    const std::string& label)
+{
+    auto key = HashBytes(std::as_bytes(descriptorSetLayouts));
+    key = HashBytes(std::as_bytes(pushConstantRanges), key);
+
+    std::shared_ptr<Entry<VkPipelineLayout>> entry;
+    {
+        std::lock_guard lock(_mutex);
+        auto& cachedEntry = _pipelineLayouts[key];
+        if (cachedEntry == nullptr)
+        {
+            cachedEntry = std::make_shared<Entry<VkPipelineLayout>>();
+        }
+
+        entry = cachedEntry;
+    }
+
+    std::call_once(entry->createOnce, [&]()
+    {
+        if (vkCreatePipelineLayout(
+            _device,
+            ToTempPtr(VkPipelineLayoutCreateInfo
+            {
+                .sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .pNext = nullptr,
+                .setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size()),
+                .pSetLayouts = descriptorSetLayouts.data(),
+                .pushConstantRangeCount = static_cast<uint32_t>(pushConstantRanges.size()),
+                .pPushConstantRanges = pushConstantRanges.data(),
+            }),
+            nullptr,
+            &entry->handle) != VK_SUCCESS)
+        {
+            entry->handle = VK_NULL_HANDLE;
+            entry->error = std::format("PipelineLibraryCache: Failed to create {}", label);
+            return;
+        }
+
+        SetDebugName(_device, entry->handle, label);
+    });
+
+    if (entry->handle == VK_NULL_HANDLE)
+    {
+        return std::unexpected(entry->error);
+    }
+
+    return entry->handle;
+}
+
+std::expected<VkPipeline, std::string> PipelineLibraryCache::Link(
+    const PipelineLibraries& libraries,
+    VkPipelineLayout pipelineLayout,
+    bool isOptimized,
+    const std::string& label)
+{
+    VkPipelineLibraryCreateInfoKHR pipelineLibraryCreateInfo =
+    {
+        .sType = VkStructureType::VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+        .pNext = nullptr,
+        .libraryCount = static_cast<uint32_t>(libraries.size()),
+        .pLibraries = libraries.data(),
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VkStructureType::VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.pNext = &pipelineLibraryCreateInfo;
+    pipelineCreateInfo.flags = isOptimized || !_isFastLinkingSupported
+        ? VkPipelineCreateFlagBits::VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT
+        : 0;
+    pipelineCreateInfo.layout = pipelineLayout;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    if (vkCreateGraphicsPipelines(_device, _pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
+    {
+        return std::unexpected(std::format("PipelineLibraryCache: Failed to link {}", label));
+    }
+
+    SetDebugName(_device, pipeline, label);
+
+    return pipeline;
+}
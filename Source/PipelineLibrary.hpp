@@ -0,0 +1,84 @@
+#pragma once
+
+#include <volk.h>
+
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The four parts VK_EXT_graphics_pipeline_library splits a graphics pipeline into
+enum class PipelineLibraryPart
+{
+    VertexInput,
+    PreRasterization,
+    FragmentShader,
+    FragmentOutput
+};
+
+constexpr size_t PIPELINE_LIBRARY_PART_COUNT = 4;
+
+using PipelineLibraries = std::array<VkPipeline, PIPELINE_LIBRARY_PART_COUNT>;
+
+// Pipeline library parts and pipeline layouts by a hash of the state they were created from, so
+// permutations sharing state share the compiled part and only the link is new. Owns everything it
+// created. Safe to use from several threads at once
+class PipelineLibraryCache
+{
+public:
+    bool Initialize(
+        VkPhysicalDevice physicalDevice,
+        VkDevice device,
+        VkPipelineCache pipelineCache,
+        bool isExtendedDynamicStateEnabled);
+    void Destroy();
+
+    // Linking without link time optimization is only quick with this property, without it
+    // pipelines are linked optimized right away
+    bool IsFastLinkingSupported() const;
+    // VK_EXT_extended_dynamic_state is optional, parts declaring its states fail without it
+    bool IsExtendedDynamicStateEnabled() const;
+
+    // Concurrent callers with the same key wait for the first one's result. createInfo has to create
+    // exactly the part, flags and library create info are filled in
+    std::expected<VkPipeline, std::string> GetOrCreateLibrary(
+        PipelineLibraryPart part,
+        uint64_t key,
+        const VkGraphicsPipelineCreateInfo& createInfo,
+        const std::string& label);
+
+    std::expected<VkPipelineLayout, std::string> GetOrCreatePipelineLayout(
+        std::span<const VkDescriptorSetLayout> descriptorSetLayouts,
+        std::span<const VkPushConstantRange> pushConstantRanges,
+        const std::string& label);
+
+    // The caller owns the linked pipeline
+    std::expected<VkPipeline, std::string> Link(
+        const PipelineLibraries& libraries,
+        VkPipelineLayout pipelineLayout,
+        bool isOptimized,
+        const std::string& label);
+
+private:
+    template<typename THandle>
+    struct Entry
+    {
+        std::once_flag createOnce;
+        THandle handle = VK_NULL_HANDLE;
+        std::string error;
+    };
+
+    VkDevice _device = {};
+    VkPipelineCache _pipelineCache = {};
+    bool _isFastLinkingSupported = false;
+    bool _isExtendedDynamicStateEnabled = false;
+
+    std::mutex _mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<Entry<VkPipeline>>> _libraries;
+    std::unordered_map<uint64_t, std::shared_ptr<Entry<VkPipelineLayout>>> _pipelineLayouts;
+};
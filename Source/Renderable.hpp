@@ -2,12 +2,14 @@
 
 #include <glm/mat4x4.hpp>
 
+#include "Pipeline.hpp"
+
 struct Mesh;
-struct Pipeline;
 
 struct Renderable
 {
     Mesh* mesh = nullptr;
-    Pipeline pipeline = {};
+    // Renderables of pipelines still compiling are not drawn
+    PipelineHandle pipeline = INVALID_PIPELINE_HANDLE;
     glm::mat4 worldMatrix = glm::mat4(1.0f);
-};
\ No newline at end of file
+};
@@ -13,11 +13,58 @@ struct VertexInputDescription
     VkPipelineVertexInputStateCreateFlags flags = 0;
 };
 
+// Where a buffer's memory lives, picked by how the CPU and GPU access it
+enum class MemoryPlacement
+{
+    // Only the GPU touches it, the CPU fills it through staging
+    DeviceLocal,
+    // Written sequentially by the CPU, read by the GPU or copied from. Persistently mapped
+    HostVisible,
+    // Device local memory the CPU writes directly, for data the GPU reads often.
+    // Without resizable BAR VMA picks host visible memory instead. Persistently mapped
+    ReBar,
+    // Written by the GPU and read back by the CPU. Persistently mapped
+    HostReadback
+};
+
+inline VmaAllocationCreateInfo ToAllocationCreateInfo(MemoryPlacement memoryPlacement)
+{
+    switch (memoryPlacement)
+    {
+        case MemoryPlacement::HostVisible:
+            return VmaAllocationCreateInfo
+            {
+                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                .usage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+            };
+        case MemoryPlacement::ReBar:
+            return VmaAllocationCreateInfo
+            {
+                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                .usage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+            };
+        case MemoryPlacement::HostReadback:
+            return VmaAllocationCreateInfo
+            {
+                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                .usage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO
+            };
+        case MemoryPlacement::DeviceLocal:
+        default:
+            return VmaAllocationCreateInfo
+            {
+                .usage = VmaMemoryUsage::VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+            };
+    }
+}
+
 struct AllocatedBuffer
 {
     VkBuffer buffer = {};
     VmaAllocation allocation = {};
     VkDeviceSize bufferSize = 0ull;
+    // Only set for buffers created with VMA_ALLOCATION_CREATE_MAPPED_BIT
+    void* mappedData = nullptr;
 };
 
 struct AllocatedImage
@@ -102,4 +149,7 @@ template <>
 struct VulkanObjectType<VkDescriptorSetLayout> { static constexpr const VkObjectType objectType = VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT; };
 
 template <>
-struct VulkanObjectType<VkDescriptorSet> { static constexpr const VkObjectType objectType = VK_OBJECT_TYPE_DESCRIPTOR_SET; };
\ No newline at end of file
+struct VulkanObjectType<VkDescriptorSet> { static constexpr const VkObjectType objectType = VK_OBJECT_TYPE_DESCRIPTOR_SET; };
+
+template <>
+struct VulkanObjectType<VkPipelineCache> { static constexpr const VkObjectType objectType = VK_OBJECT_TYPE_PIPELINE_CACHE; };
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <format>
+#include <string>
+
+#include "Types.hpp"
+
+struct UploadAllocation
+{
+    void* data = nullptr;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+};
+
+// Linear allocator over a persistently mapped buffer, every frame in flight owns one and
+// together they form the ring. Reset once the frame's render fence has signaled, everything
+// the frame uploads is bump-allocated from it and handed to the GPU as a dynamic offset
+class UploadRing
+{
+public:
+    void Initialize(const AllocatedBuffer& buffer)
+    {
+        _buffer = buffer;
+        _head = 0;
+    }
+
+    void Reset()
+    {
+        _head = 0;
+    }
+
+    // alignment has to be a power of two, which all of Vulkan's offset alignments are
+    std::expected<UploadAllocation, std::string> Allocate(VkDeviceSize size, VkDeviceSize alignment)
+    {
+        auto offset = alignment > 1
+            ? (_head + alignment - 1) & ~(alignment - 1)
+            : _head;
+        if (offset + size > _buffer.bufferSize)
+        {
+            return std::unexpected(std::format("UploadRing: Out of space, {} bytes requested with {} of {} bytes in use", size, _head, _buffer.bufferSize));
+        }
+
+        _head = offset + size;
+
+        return UploadAllocation
+        {
+            .data = static_cast<uint8_t*>(_buffer.mappedData) + offset,
+            .offset = offset,
+            .size = size
+        };
+    }
+
+    template<typename TData>
+    std::expected<UploadAllocation, std::string> Upload(const TData& data, VkDeviceSize alignment)
+    {
+        auto allocationResult = Allocate(sizeof(TData), alignment);
+        if (allocationResult.has_value())
+        {
+            std::memcpy(allocationResult->data, &data, sizeof(TData));
+        }
+
+        return allocationResult;
+    }
+
+    const AllocatedBuffer& GetBuffer() const { return _buffer; }
+    VkDeviceSize GetUsedSize() const { return _head; }
+
+private:
+    AllocatedBuffer _buffer = {};
+    VkDeviceSize _head = 0;
+};
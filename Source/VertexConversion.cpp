@@ -0,0 +1,300 @@
+#include "VertexConversion.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <glm/common.hpp>
+#include <glm/gtc/packing.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    template<typename TComponent>
+    void ConvertComponentsToFloatScalar(const TComponent* source, float* destination, size_t first, size_t count, bool normalized)
+    {
+        constexpr auto scale = 1.0f / static_cast<float>(std::numeric_limits<TComponent>::max());
+        for (size_t i = first; i < count; i++)
+        {
+            auto value = static_cast<float>(source[i]);
+            destination[i] = normalized
+                ? std::max(value * scale, -1.0f)
+                : value;
+        }
+    }
+
+    template<typename TSourceIndex, typename TDestinationIndex>
+    void ConvertIndicesScalar(const TSourceIndex* source, TDestinationIndex* destination, size_t first, size_t count)
+    {
+        for (size_t i = first; i < count; i++)
+        {
+            destination[i] = static_cast<TDestinationIndex>(std::min<uint64_t>(source[i], std::numeric_limits<TDestinationIndex>::max()));
+        }
+    }
+
+    // Folds the unit sphere onto the [-1, 1] square, the lower hemisphere mirrored into the corners
+    glm::vec2 EncodeOctahedral(const glm::vec3& normal)
+    {
+        auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+        if (length == 0.0f)
+        {
+            return glm::vec2(0.0f);
+        }
+
+        auto projected = glm::vec2(normal.x, normal.y) / length;
+        if (normal.z < 0.0f)
+        {
+            projected = glm::vec2(
+                (1.0f - std::abs(projected.y)) * (projected.x >= 0.0f ? 1.0f : -1.0f),
+                (1.0f - std::abs(projected.x)) * (projected.y >= 0.0f ? 1.0f : -1.0f));
+        }
+
+        return projected;
+    }
+
+#if defined(__AVX2__)
+    // Eight integers already widened to int32 lanes
+    void StoreAsFloat(__m256i values, float* destination, bool normalized, float scale)
+    {
+        auto floats = _mm256_cvtepi32_ps(values);
+        if (normalized)
+        {
+            floats = _mm256_max_ps(_mm256_mul_ps(floats, _mm256_set1_ps(scale)), _mm256_set1_ps(-1.0f));
+        }
+
+        _mm256_storeu_ps(destination, floats);
+    }
+#endif
+}
+
+void InterleavePositionNormalUv(
+    const std::byte* positions,
+    size_t positionStride,
+    const std::byte* normals,
+    size_t normalStride,
+    const std::byte* uvs,
+    size_t uvStride,
+    size_t count,
+    VertexPositionNormalUv* vertices,
+    glm::vec3& boundsMin,
+    glm::vec3& boundsMax)
+{
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
+
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    // A vertex is exactly 8 floats, it is assembled in two halves [px py pz nx] [ny nz u v] and written
+    // with one store. The 16 byte loads read one float past position and normal, so the last vertex
+    // is left to the scalar loop to never read past the end of the accessor
+    auto minimum = _mm_set1_ps(std::numeric_limits<float>::max());
+    auto maximum = _mm_set1_ps(std::numeric_limits<float>::lowest());
+    const auto zero = _mm_setzero_ps();
+
+    for (; i + 1 < count; i++)
+    {
+        auto position = _mm_loadu_ps(reinterpret_cast<const float*>(positions + i * positionStride));
+        auto normal = normals != nullptr
+            ? _mm_loadu_ps(reinterpret_cast<const float*>(normals + i * normalStride))
+            : zero;
+        auto uv = uvs != nullptr
+            ? _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(uvs + i * uvStride)))
+            : zero;
+
+        auto low = _mm_blend_ps(position, _mm_shuffle_ps(normal, normal, _MM_SHUFFLE(0, 0, 0, 0)), 0b1000);
+        auto high = _mm_shuffle_ps(normal, uv, _MM_SHUFFLE(1, 0, 2, 1));
+        _mm256_storeu_ps(reinterpret_cast<float*>(vertices + i), _mm256_set_m128(high, low));
+
+        minimum = _mm_min_ps(minimum, position);
+        maximum = _mm_max_ps(maximum, position);
+    }
+
+    alignas(16) float minimumLanes[4];
+    alignas(16) float maximumLanes[4];
+    _mm_store_ps(minimumLanes, minimum);
+    _mm_store_ps(maximumLanes, maximum);
+    boundsMin = glm::vec3(minimumLanes[0], minimumLanes[1], minimumLanes[2]);
+    boundsMax = glm::vec3(maximumLanes[0], maximumLanes[1], maximumLanes[2]);
+#endif
+
+    for (; i < count; i++)
+    {
+        VertexPositionNormalUv vertex = {};
+        std::memcpy(&vertex.position, positions + i * positionStride, sizeof(glm::vec3));
+        if (normals != nullptr)
+        {
+            std::memcpy(&vertex.normal, normals + i * normalStride, sizeof(glm::vec3));
+        }
+        if (uvs != nullptr)
+        {
+            std::memcpy(&vertex.uv, uvs + i * uvStride, sizeof(glm::vec2));
+        }
+
+        vertices[i] = vertex;
+
+        boundsMin = glm::min(boundsMin, vertex.position);
+        boundsMax = glm::max(boundsMax, vertex.position);
+    }
+
+    if (count == 0)
+    {
+        boundsMin = glm::vec3(0.0f);
+        boundsMax = glm::vec3(0.0f);
+    }
+}
+
+void PackVertices(
+    const VertexPositionNormalUv* vertices,
+    size_t count,
+    const glm::vec3& positionOffset,
+    const glm::vec3& positionScale,
+    VertexPackedPositionNormalUv* packedVertices)
+{
+    auto inversePositionScale = 1.0f / positionScale;
+    for (size_t i = 0; i < count; i++)
+    {
+        auto& vertex = vertices[i];
+        auto position = (vertex.position - positionOffset) * inversePositionScale;
+        auto normal = EncodeOctahedral(vertex.normal);
+
+        VertexPackedPositionNormalUv packedVertex = {};
+        packedVertex.position[0] = static_cast<int16_t>(glm::packSnorm1x16(position.x));
+        packedVertex.position[1] = static_cast<int16_t>(glm::packSnorm1x16(position.y));
+        packedVertex.position[2] = static_cast<int16_t>(glm::packSnorm1x16(position.z));
+        packedVertex.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+        packedVertex.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+        packedVertex.uv[0] = glm::packHalf1x16(vertex.uv.x);
+        packedVertex.uv[1] = glm::packHalf1x16(vertex.uv.y);
+
+        packedVertices[i] = packedVertex;
+    }
+}
+
+void ConvertComponentsToFloat(const int8_t* source, float* destination, size_t count, bool normalized)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i));
+        StoreAsFloat(_mm256_cvtepi8_epi32(packed), destination + i, normalized, 1.0f / 127.0f);
+    }
+#endif
+
+    ConvertComponentsToFloatScalar(source, destination, i, count, normalized);
+}
+
+void ConvertComponentsToFloat(const uint8_t* source, float* destination, size_t count, bool normalized)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i));
+        StoreAsFloat(_mm256_cvtepu8_epi32(packed), destination + i, normalized, 1.0f / 255.0f);
+    }
+#endif
+
+    ConvertComponentsToFloatScalar(source, destination, i, count, normalized);
+}
+
+void ConvertComponentsToFloat(const int16_t* source, float* destination, size_t count, bool normalized)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        StoreAsFloat(_mm256_cvtepi16_epi32(packed), destination + i, normalized, 1.0f / 32767.0f);
+    }
+#endif
+
+    ConvertComponentsToFloatScalar(source, destination, i, count, normalized);
+}
+
+void ConvertComponentsToFloat(const uint16_t* source, float* destination, size_t count, bool normalized)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        StoreAsFloat(_mm256_cvtepu16_epi32(packed), destination + i, normalized, 1.0f / 65535.0f);
+    }
+#endif
+
+    ConvertComponentsToFloatScalar(source, destination, i, count, normalized);
+}
+
+void WidenIndices(const uint8_t* source, uint16_t* destination, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= count; i += 16)
+    {
+        auto packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_cvtepu8_epi16(packed));
+    }
+#endif
+
+    ConvertIndicesScalar(source, destination, i, count);
+}
+
+void WidenIndices(const uint8_t* source, uint32_t* destination, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        auto packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_cvtepu8_epi32(packed));
+    }
+#endif
+
+    ConvertIndicesScalar(source, destination, i, count);
+}
+
+void WidenIndices(const uint16_t* source, uint32_t* destination, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= count; i += 16)
+    {
+        auto packed = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(packed)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(packed, 1)));
+    }
+#endif
+
+    ConvertIndicesScalar(source, destination, i, count);
+}
+
+void NarrowIndices(const uint32_t* source, uint16_t* destination, size_t count)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    // packus works per 128 bit lane, the permute puts the four 64 bit results back in order
+    for (; i + 16 <= count; i += 16)
+    {
+        auto low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        auto high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i + 8));
+        auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), packed);
+    }
+#endif
+
+    ConvertIndicesScalar(source, destination, i, count);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+#include "Mesh.hpp"
+
+// Kernels turning glTF accessor data into the engine's vertex and index formats.
+// They are vectorized with AVX2 when the engine is compiled with it, which it is by default,
+// and fall back to plain loops otherwise. Strides are in bytes, like a glTF buffer view's byteStride
+
+// Writes count interleaved vertices from tightly or strided packed float3 positions, float3 normals
+// and float2 uvs, and returns the bounds of the positions. normals and uvs may be nullptr, they are
+// zero filled then. vertices is only ever written to, it can point into write combined memory
+void InterleavePositionNormalUv(
+    const std::byte* positions,
+    size_t positionStride,
+    const std::byte* normals,
+    size_t normalStride,
+    const std::byte* uvs,
+    size_t uvStride,
+    size_t count,
+    VertexPositionNormalUv* vertices,
+    glm::vec3& boundsMin,
+    glm::vec3& boundsMax);
+
+// Quantizes positions to snorm16 of (position - positionOffset) / positionScale, encodes normals
+// octahedrally and uvs as half floats. packedVertices is only ever written to
+void PackVertices(
+    const VertexPositionNormalUv* vertices,
+    size_t count,
+    const glm::vec3& positionOffset,
+    const glm::vec3& positionScale,
+    VertexPackedPositionNormalUv* packedVertices);
+
+// Converts count integer components to float, as KHR_mesh_quantization stores them.
+// Normalized signed components map to max(c / c_max, -1), unsigned ones to c / c_max
+void ConvertComponentsToFloat(const int8_t* source, float* destination, size_t count, bool normalized);
+void ConvertComponentsToFloat(const uint8_t* source, float* destination, size_t count, bool normalized);
+void ConvertComponentsToFloat(const int16_t* source, float* destination, size_t count, bool normalized);
+void ConvertComponentsToFloat(const uint16_t* source, float* destination, size_t count, bool normalized);
+
+void WidenIndices(const uint8_t* source, uint16_t* destination, size_t count);
+void WidenIndices(const uint8_t* source, uint32_t* destination, size_t count);
+void WidenIndices(const uint16_t* source, uint32_t* destination, size_t count);
+// Every index has to fit into 16 bits, larger ones are clamped
+void NarrowIndices(const uint32_t* source, uint16_t* destination, size_t count);
@@ -31,7 +31,7 @@ layout(set = 1, binding = 0, std140) readonly buffer ObjectBuffer
 
 void main()
 {
-    mat4 object_world_matrix = u_object_buffer.objects[gl_BaseInstance].world_matrix;
+    mat4 object_world_matrix = u_object_buffer.objects[gl_InstanceIndex].world_matrix;
     gl_Position = u_camera.projection_matrix * u_camera.view_matrix * object_world_matrix * vec4(i_position, 1.0f);
     v_uv = i_uv;
 }